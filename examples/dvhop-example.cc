@@ -11,42 +11,16 @@
 #include <iostream>
 #include <cmath>
 #include <random>
+#include <algorithm>
 
 using namespace ns3;
 
 
-struct point 
-{
-    double x,y;
-};
-
-float norm (point p) // get the norm of a vector
+// Writes "time node x y" each time a node estimate changes
+void
+EstimateChanged (Ptr<OutputStreamWrapper> stream, uint32_t nodeId, double x, double y)
 {
-    return pow(pow(p.x,2)+pow(p.y,2),.5);
-}
-
-point trilateration(point point1, point point2, point point3, double r1, double r2, double r3) {
-    point resultPose;
-    //unit vector in a direction from point1 to point 2
-    double p2p1Distance = pow(pow(point2.x-point1.x,2) + pow(point2.y - point1.y,2),0.5);
-    point ex = {(point2.x-point1.x)/p2p1Distance, (point2.y-point1.y)/p2p1Distance};
-    point aux = {point3.x-point1.x,point3.y-point1.y};
-    //signed magnitude of the x component
-    double i = ex.x * aux.x + ex.y * aux.y;
-    //the unit vector in the y direction. 
-    point aux2 = { point3.x-point1.x-i*ex.x, point3.y-point1.y-i*ex.y};
-    point ey = { aux2.x / norm (aux2), aux2.y / norm (aux2) };
-    //the signed magnitude of the y component
-    double j = ey.x * aux.x + ey.y * aux.y;
-    //coordinates
-    double x = (pow(r1,2) - pow(r2,2) + pow(p2p1Distance,2))/ (2 * p2p1Distance);
-    double y = (pow(r1,2) - pow(r3,2) + pow(i,2) + pow(j,2))/(2*j) - i*x/j;
-    //result coordinates
-    double finalX = point1.x+ x*ex.x + y*ey.x;
-    double finalY = point1.y+ x*ex.y + y*ey.y;
-    resultPose.x = finalX;
-    resultPose.y = finalY;
-    return resultPose;
+  *stream->GetStream () << Simulator::Now ().GetSeconds () << " " << nodeId << " " << x << " " << y << std::endl;
 }
 
 /**
@@ -79,6 +53,18 @@ private:
   bool pcap;
   /// Print routes if true
   bool printRoutes;
+  /// Beacons used to localize each node, 0 uses all of them
+  uint32_t maxBeacons;
+  /// Threads used to localize the nodes, 0 uses the hardware concurrency
+  uint32_t threads;
+  /// Write the position estimates of the nodes over time if true
+  bool traceEstimates;
+  /// Per-node protocol statistics file, JSON if it ends in .json, CSV otherwise
+  std::string statsFile;
+  /// Stop once no table changed for this long, seconds, 0 runs for totalTime
+  double quietPeriod;
+  /// Snapshot of a converged run of the same scenario to start from, empty for a cold start
+  std::string warmStart;
   //\}
 
   ///\name network
@@ -88,6 +74,11 @@ private:
   Ipv4InterfaceContainer interfaces;
   //\}
 
+  /// Protocol statistics of every node at the end of the simulation
+  std::vector<dvhop::Statistics> stats;
+  /// Stops the simulation when the tables converge
+  DVHopConvergenceMonitor monitor;
+
 private:
   void CreateNodes ();
   void CreateDevices ();
@@ -96,6 +87,8 @@ private:
   void CreateBeacons();
   void Kill();
   void DV();
+  void WriteSnapshot();
+  void Converged();
 };
 
 int main (int argc, char **argv)
@@ -115,7 +108,13 @@ DVHopExample::DVHopExample () :
   beacons(10),
   totalTime (10),
   pcap (false),
-  printRoutes (false)
+  printRoutes (false),
+  maxBeacons (0),
+  threads (0),
+  traceEstimates (false),
+  statsFile ("dvhop.stats.csv"),
+  quietPeriod (0),
+  warmStart ("")
 {
 }
 
@@ -132,6 +131,13 @@ DVHopExample::Configure (int argc, char **argv)
   cmd.AddValue ("printRoutes", "Print routing table dumps.", printRoutes);
   cmd.AddValue ("size", "Number of nodes.", size);
   cmd.AddValue ("time", "Simulation time, s.", totalTime);
+  cmd.AddValue ("maxBeacons", "Beacons with the fewest hops used to localize each node, 0 for all.", maxBeacons);
+  cmd.AddValue ("threads", "Threads used to localize the nodes, 0 for all cores.", threads);
+  cmd.AddValue ("traceEstimates", "Write the position estimates over time.", traceEstimates);
+  cmd.AddValue ("statsFile", "Per-node statistics file, .json for JSON, CSV otherwise.", statsFile);
+  cmd.AddValue ("quietPeriod", "Stop once no table or hop size changed for this long, s. 0 runs for the whole time, "
+                "shorter periods are raised to HopSizeHoldTime + 2 HelloInterval so the hop sizes can be flooded.", quietPeriod);
+  cmd.AddValue ("warmStart", "Start from the tables of a snapshot written by a previous run of the same scenario.", warmStart);
 
   cmd.Parse (argc, argv);
   return true;
@@ -146,17 +152,77 @@ DVHopExample::Run ()
   InstallInternetStack ();
   CreateBeacons();
 
+  if (!warmStart.empty ())
+    {
+      if (DVHopHelper::LoadSnapshot (nodes, warmStart))
+        {
+          std::cout << "Warm start from " << warmStart << "\n";
+        }
+      else
+        {
+          std::cout << warmStart << " does not match this scenario, starting cold\n";
+        }
+    }
+
   std::cout << "Starting simulation for " << totalTime << " s ...\n";
 
+  // The tables are written when they converge, or at the end
+  if (quietPeriod > 0)
+    {
+      // The beacons compute their hop size HopSizeHoldTime after the tables settle,
+      // then it moves one hop per HELLO, each adoption restarting the quiet period
+      Ptr<dvhop::RoutingProtocol> protocol = nodes.Get (0)->GetObject<dvhop::RoutingProtocol> ();
+      TimeValue holdTime;
+      TimeValue helloInterval;
+      protocol->GetAttribute ("HopSizeHoldTime", holdTime);
+      protocol->GetAttribute ("HelloInterval", helloInterval);
+      double minimum = holdTime.Get ().GetSeconds () + 2 * helloInterval.Get ().GetSeconds ();
+      if (quietPeriod < minimum)
+        {
+          std::cout << "Quiet period raised to " << minimum << " s for the hop sizes\n";
+          quietPeriod = minimum;
+        }
+      monitor.SetQuietPeriod (Seconds (quietPeriod));
+      monitor.SetConvergedCallback (MakeCallback (&DVHopExample::Converged, this));
+      monitor.Install (nodes);
+    }
+  Simulator::Schedule (Seconds (totalTime), &DVHopExample::WriteSnapshot, this);
   Simulator::Stop (Seconds (totalTime));
 
   AnimationInterface anim("animation.xml");
 
   Simulator::Run ();
   DV();
+
+  stats = DVHopHelper::CollectStatistics (nodes);
+  if (!statsFile.empty ())
+    {
+      bool json = statsFile.size () >= 5 && statsFile.compare (statsFile.size () - 5, 5, ".json") == 0;
+      Ptr<OutputStreamWrapper> statsStream = Create<OutputStreamWrapper> (statsFile, std::ios::out);
+      DVHopHelper::WriteStatistics (nodes, statsStream, json);
+    }
   Simulator::Destroy ();
 }
 
+void
+DVHopExample::WriteSnapshot ()
+{
+  // Binary, read it with dvhop-snapshot-reader
+  if (!DVHopHelper::WriteSnapshot (nodes, "dvhop.snapshot"))
+    {
+      std::cerr << "Could not write dvhop.snapshot\n";
+    }
+}
+
+void
+DVHopExample::Converged ()
+{
+  std::cout << "Tables and hop sizes converged at " << monitor.GetLastChange ().GetSeconds () << " s, stopping at "
+            << Simulator::Now ().GetSeconds () << " s\n";
+  WriteSnapshot ();
+  Simulator::Stop ();
+}
+
 void
 DVHopExample::Kill() {
   // pick 2 random nodes and kill them
@@ -179,8 +245,28 @@ DVHopExample::Kill() {
 
 
 void
-DVHopExample::Report (std::ostream &)
+DVHopExample::Report (std::ostream & os)
 {
+  uint32_t helloTx = 0;
+  uint64_t bytesTx = 0;
+  uint64_t updatesApplied = 0;
+  uint64_t updatesIgnored = 0;
+  uint64_t tableSize = 0;
+  Time converged;
+  for (const dvhop::Statistics &s : stats)
+    {
+      helloTx += s.helloTx;
+      bytesTx += s.bytesTx;
+      updatesApplied += s.updatesApplied;
+      updatesIgnored += s.updatesIgnored;
+      tableSize += s.tableSize;
+      converged = std::max (converged, s.lastTableChange);
+    }
+
+  os << "HELLOs sent: " << helloTx << ", " << bytesTx << " bytes\n";
+  os << "Updates applied: " << updatesApplied << ", ignored: " << updatesIgnored << "\n";
+  os << "Mean table size: " << (stats.empty () ? 0 : double (tableSize) / stats.size ()) << "\n";
+  os << "Last table change: " << converged.GetSeconds () << " s\n";
 }
 
 void
@@ -228,6 +314,14 @@ DVHopExample::CreateBeacons ()
     dvhop->SetPosition (position.x, position.y);
   }
 
+  if (traceEstimates) {
+    Ptr<OutputStreamWrapper> stream = Create<OutputStreamWrapper>("dvhop.estimates", std::ios::out);
+    for (uint32_t i = beacons; i < size; i++) {
+      Ptr<Node> node = nodes.Get(i);
+      node -> GetObject<dvhop::RoutingProtocol> () -> TraceConnectWithoutContext ("PositionEstimate", MakeBoundCallback (&EstimateChanged, stream, node -> GetId ()));
+    }
+  }
+
   // // Increase the position of all nodes 10x
   //   for (int i = 0; i < 4; i++) {
   //   ns3::Ptr<ns3::Node> node = nodes.Get(i);
@@ -272,8 +366,6 @@ DVHopExample::InstallInternetStack ()
   address.SetBase ("10.0.0.0", "255.0.0.0");
   interfaces = address.Assign (devices);
 
-  Ptr<OutputStreamWrapper> distStream = Create<OutputStreamWrapper>("dvhop.distances", std::ios::out);
-  dvhop.PrintDistanceTableAllAt(Seconds(9), distStream);
 
   if (printRoutes)
     {
@@ -283,93 +375,17 @@ DVHopExample::InstallInternetStack ()
 }
 
 void DVHopExample::DV () {
-  // 10.0.0.1 -> 10.0.0.beacons are beacons
-  std::map<Ipv4Address, float> hopsize;
-  uint32_t i = 0;
-
-  // Calculate expected size per hop
-  for (i = 0; i < beacons; i++) {
-    Ptr<Ipv4RoutingProtocol> proto = nodes.Get(i) -> GetObject<Ipv4>() -> GetRoutingProtocol ();
-    Ptr<dvhop::RoutingProtocol> dvhop = DynamicCast<dvhop::RoutingProtocol> (proto);
-    ns3::dvhop::DistanceTable table = dvhop -> GetDistanceTable();
-    std::map<Ipv4Address, ns3::dvhop::BeaconInfo> inner = table.Inner();
-
-    double x1 = dvhop -> GetXPosition();
-    double y1 = dvhop -> GetYPosition();
-
-    int hops = 0;
-    double sum = 0;
-
-    for (const auto& kv : inner) {
-      ns3::dvhop::BeaconInfo info = kv.second;
-
-      double x2 = info.GetPosition().first;
-      double y2 = info.GetPosition().second;
-
-      sum += sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
-      hops += info.GetHops();
-    }
-
-    Ipv4Address ipv4 = (dvhop -> GetIpv4() -> GetAddress(1, 0)).GetAddress();
-
-    if (hops == 0) {
-      hopsize[ipv4] = 0;
-    } else {
-      hopsize[ipv4] = sum / hops;
-    }
-  }
-
-  // Each node now tries to trilateral
-  double error = 0;
-  int count = 0;
-
-  for (i = beacons; i < size; i++) {
-    auto node = nodes.Get(i);
-    Ptr<Ipv4RoutingProtocol> proto = node -> GetObject<Ipv4>() -> GetRoutingProtocol ();
-    Ptr<dvhop::RoutingProtocol> dvhop = DynamicCast<dvhop::RoutingProtocol> (proto);
-    ns3::dvhop::DistanceTable table = dvhop -> GetDistanceTable();
-    std::map<Ipv4Address, ns3::dvhop::BeaconInfo> inner = table.Inner();
-
-    // We can't trilaterate with less than 3 nodes
-    if (inner.size() >= 3) {
-      auto itr = inner.begin();
-
-      double xa = itr->second.GetPosition().first;
-      double ya = itr->second.GetPosition().second;
-
-      // hops size * hops to node
-      double ra = hopsize[itr -> first] * itr->second.GetHops();
-
-      itr++;
-
-      double xb = itr->second.GetPosition().first;
-      double yb = itr->second.GetPosition().second;
-
-      // hops size * hops to node
-      double rb = hopsize[itr -> first] * itr->second.GetHops();
-
-      itr++;
-      
-      double xc = itr->second.GetPosition().first;
-      double yc = itr->second.GetPosition().second;
-
-      // hops size * hops to node
-      double rc = hopsize[itr -> first] * itr->second.GetHops();
-
-      point pa = {xa, ya};
-      point pb = {xb, yb};
-      point pc = {xc, yc};
-      point final = trilateration(pa, pb, pc, ra, rb, rc);
-
-      Vector position = node -> GetObject<MobilityModel> () -> GetPosition();
-
-      // Add distance to the error
-      error += sqrt((final.x - position.x) * (final.x - position.x) + (final.y - position.y) * (final.y - position.y));
-      count++;
-  
-      std::cout << final.x << "," << final.y << " | " << position.x << "," << position.y << std::endl;       
+  // Hop sizes are computed by the beacons and flooded with the HELLOs,
+  // each node uses the one from its nearest beacon
+  std::vector<DVHopLocalization> results = DVHopHelper::Localize (nodes, threads, maxBeacons);
+
+  for (const DVHopLocalization &result : results) {
+    if (result.localized) {
+      Vector position = NodeList::GetNode(result.nodeId) -> GetObject<MobilityModel> () -> GetPosition();
+      std::cout << result.x << "," << result.y << " | " << position.x << "," << position.y << std::endl;
     }
   }
 
-  std::cout << error << " | " << count << std::endl;
+  DVHopLocalizationSummary summary = DVHopHelper::Summarize (results);
+  std::cout << summary.meanError * summary.localized << " | " << summary.localized << std::endl;
 }
@@ -0,0 +1,199 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/dvhop-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+/**
+ * \brief Scaling benchmark.
+ *
+ * Sweeps the node count, beacon ratio, density and duration and prints one CSV
+ * row per point with the wall-clock time, the simulator event count, the peak
+ * RSS, the control bytes per node and the convergence time. Each point runs in
+ * a child process by default, so the peak RSS is not inherited from the
+ * previous points.
+ */
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  struct Point
+  {
+    uint32_t nodes;
+    double   beaconRatio;
+    double   density;   // nodes per 100 m x 100 m
+    double   duration;  // seconds
+  };
+
+  template <typename T>
+  std::vector<T>
+  ParseList (std::string const &list)
+  {
+    std::vector<T> values;
+    std::istringstream is (list);
+    std::string item;
+    while (std::getline (is, item, ','))
+      {
+        std::istringstream value (item);
+        T v;
+        if (value >> v)
+          {
+            values.push_back (v);
+          }
+      }
+    return values;
+  }
+
+  double
+  Elapsed (Clock::time_point start, Clock::time_point end)
+  {
+    return std::chrono::duration<double> (end - start).count ();
+  }
+
+  void
+  RunPoint (Point const &p)
+  {
+    Clock::time_point start = Clock::now ();
+
+    double side = 100 * std::sqrt (p.nodes / p.density);
+    uint32_t beacons = std::max<uint32_t> (3, std::ceil (p.beaconRatio * p.nodes));
+
+    NodeContainer nodes;
+    nodes.Create (p.nodes);
+
+    Ptr<UniformRandomVariable> xs = CreateObject<UniformRandomVariable> ();
+    xs->SetAttribute ("Max", DoubleValue (side));
+    Ptr<UniformRandomVariable> ys = CreateObject<UniformRandomVariable> ();
+    ys->SetAttribute ("Max", DoubleValue (side));
+    Ptr<RandomRectanglePositionAllocator> allocator = CreateObject<RandomRectanglePositionAllocator> ();
+    allocator->SetX (xs);
+    allocator->SetY (ys);
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator (allocator);
+    mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+    mobility.Install (nodes);
+
+    WifiMacHelper wifiMac;
+    wifiMac.SetType ("ns3::AdhocWifiMac");
+    YansWifiPhyHelper wifiPhy = YansWifiPhyHelper ();
+    YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
+    wifiPhy.SetChannel (wifiChannel.Create ());
+    WifiHelper wifi;
+    wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("OfdmRate6Mbps"), "RtsCtsThreshold", UintegerValue (0));
+    NetDeviceContainer devices = wifi.Install (wifiPhy, wifiMac, nodes);
+
+    DVHopHelper dvhop;
+    InternetStackHelper stack;
+    stack.SetRoutingHelper (dvhop);
+    stack.Install (nodes);
+    Ipv4AddressHelper address;
+    address.SetBase ("10.0.0.0", "255.0.0.0");
+    address.Assign (devices);
+
+    for (uint32_t i = 0; i < beacons && i < p.nodes; i++)
+      {
+        Ptr<dvhop::RoutingProtocol> protocol = nodes.Get (i)->GetObject<dvhop::RoutingProtocol> ();
+        Vector position = nodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+        protocol->SetIsBeacon (true);
+        protocol->SetPosition (position.x, position.y);
+      }
+
+    Clock::time_point setup = Clock::now ();
+    Simulator::Stop (Seconds (p.duration));
+    Simulator::Run ();
+    Clock::time_point run = Clock::now ();
+
+    std::vector<dvhop::Statistics> stats = DVHopHelper::CollectStatistics (nodes);
+    uint64_t bytesTx = 0;
+    uint64_t tableSize = 0;
+    Time converged;
+    for (size_t i = 0; i < stats.size (); i++)
+      {
+        bytesTx += stats[i].bytesTx;
+        tableSize += stats[i].tableSize;
+        converged = std::max (converged, stats[i].lastTableChange);
+      }
+    uint64_t events = Simulator::GetEventCount ();
+    Simulator::Destroy ();
+
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+
+    std::cout << p.nodes << "," << p.beaconRatio << "," << p.density << "," << p.duration << ","
+              << side << "," << Elapsed (start, setup) << "," << Elapsed (setup, run) << ","
+              << events << "," << usage.ru_maxrss << ","
+              << double (bytesTx) / p.nodes << "," << converged.GetSeconds () << ","
+              << double (tableSize) / p.nodes << std::endl;
+  }
+}
+
+int main (int argc, char **argv)
+{
+  std::string nodeCounts = "100,1000";
+  std::string beaconRatios = "0.1";
+  std::string densities = "20";
+  std::string durations = "10";
+  bool isolate = true;
+
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Comma separated node counts.", nodeCounts);
+  cmd.AddValue ("beaconRatios", "Comma separated fractions of beacons, at least 3 beacons are used.", beaconRatios);
+  cmd.AddValue ("densities", "Comma separated densities, nodes per 100 m x 100 m.", densities);
+  cmd.AddValue ("durations", "Comma separated simulation times, s.", durations);
+  cmd.AddValue ("isolate", "Run each point in a child process so the peak RSS is per point.", isolate);
+  cmd.Parse (argc, argv);
+
+  SeedManager::SetSeed (12345);
+
+  std::cout << "nodes,beaconRatio,density,duration,side,setupSeconds,runSeconds,events,peakRssKb,"
+            << "controlBytesPerNode,convergenceSeconds,meanTableSize" << std::endl;
+
+  std::vector<uint32_t> n = ParseList<uint32_t> (nodeCounts);
+  std::vector<double> r = ParseList<double> (beaconRatios);
+  std::vector<double> d = ParseList<double> (densities);
+  std::vector<double> t = ParseList<double> (durations);
+  for (size_t a = 0; a < n.size (); a++)
+    for (size_t b = 0; b < r.size (); b++)
+      for (size_t c = 0; c < d.size (); c++)
+        for (size_t e = 0; e < t.size (); e++)
+          {
+            Point p = { n[a], r[b], d[c], t[e] };
+            if (!isolate)
+              {
+                RunPoint (p);
+                continue;
+              }
+            pid_t child = fork ();
+            if (child < 0)
+              {
+                NS_FATAL_ERROR ("fork failed, run with --isolate=false");
+              }
+            if (child == 0)
+              {
+                RunPoint (p);
+                _exit (0);
+              }
+            int status;
+            waitpid (child, &status, 0);
+            if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+              {
+                std::cerr << "Point " << n[a] << " nodes failed" << std::endl;
+              }
+          }
+
+  return 0;
+}
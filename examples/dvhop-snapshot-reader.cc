@@ -0,0 +1,86 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/dvhop-module.h"
+#include "ns3/core-module.h"
+#include <iostream>
+#include <algorithm>
+
+using namespace ns3;
+
+/**
+ * \brief Offline reader of the binary distance table snapshots.
+ *
+ * Maps a snapshot written by DVHopHelper::WriteSnapshot and prints a summary,
+ * the table of one node, or every record as text.
+ */
+
+namespace
+{
+  void
+  PrintRecord (dvhop::SnapshotRecord const &r)
+  {
+    std::cout << r.node << "\t" << Ipv4Address (r.beacon) << "\t" << Ipv4Address (r.nextHop) << "\t"
+              << r.interface << "\t" << r.hops << "\t" << r.seqNo << "\t(" << r.x << "," << r.y << ")\t"
+              << NanoSeconds (r.updatedAt).GetSeconds () << "\n";
+  }
+}
+
+int main (int argc, char **argv)
+{
+  std::string file = "dvhop.snapshot";
+  int64_t node = -1;
+  bool text = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("file", "Snapshot file.", file);
+  cmd.AddValue ("node", "Print the table of this node only.", node);
+  cmd.AddValue ("text", "Print every record as text.", text);
+  cmd.Parse (argc, argv);
+
+  dvhop::SnapshotReader reader;
+  if (!reader.Open (file))
+    {
+      NS_FATAL_ERROR ("Could not read " << file << ", not a DV-Hop snapshot of this version");
+    }
+
+  dvhop::SnapshotRecord const *begin = reader.Begin ();
+  dvhop::SnapshotRecord const *end = reader.End ();
+  if (node >= 0)
+    {
+      reader.FindNode (node, begin, end);
+      text = true;
+    }
+  if (text)
+    {
+      std::cout << "node\tbeacon\tnextHop\tinterface\thops\tseqNo\tposition\tupdated\n";
+      for (dvhop::SnapshotRecord const *r = begin; r != end; ++r)
+        {
+          PrintRecord (*r);
+        }
+      return 0;
+    }
+
+  dvhop::SnapshotHeader const &header = reader.GetHeader ();
+  uint64_t hops = 0;
+  uint16_t maxHops = 0;
+  for (dvhop::SnapshotRecord const *r = begin; r != end; ++r)
+    {
+      hops += r->hops;
+      maxHops = std::max (maxHops, r->hops);
+    }
+  uint32_t beacons = 0;
+  uint32_t withHopSize = 0;
+  for (dvhop::SnapshotNode const *n = reader.BeginNodes (); n != reader.EndNodes (); ++n)
+    {
+      beacons += (n->flags & dvhop::SnapshotNode::BEACON) != 0;
+      withHopSize += (n->flags & dvhop::SnapshotNode::HAS_HOP_SIZE) != 0;
+    }
+  std::cout << "Time: " << NanoSeconds (header.time).GetSeconds () << " s\n"
+            << "Topology: " << std::hex << header.topology << std::dec << "\n"
+            << "Nodes: " << header.nodes << " (" << beacons << " beacons, " << withHopSize << " with a hop size)\n"
+            << "Records: " << header.records << "\n"
+            << "Mean table size: " << (header.nodes ? double (header.records) / header.nodes : 0) << "\n"
+            << "Mean hops: " << (header.records ? double (hops) / header.records : 0) << "\n"
+            << "Max hops: " << maxHops << std::endl;
+  return 0;
+}
@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dvhop-convergence-monitor.h"
+#include "ns3/dvhop.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+  NS_LOG_COMPONENT_DEFINE ("DVHopConvergenceMonitor");
+
+  DVHopConvergenceMonitor::DVHopConvergenceMonitor ()
+    : m_quietPeriod (Seconds (5)),
+      m_lastChange (Seconds (0)),
+      m_converged (false)
+  {
+  }
+
+  void
+  DVHopConvergenceMonitor::Install (NodeContainer c)
+  {
+    for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        Ptr<dvhop::RoutingProtocol> dvhop = (*i)->GetObject<dvhop::RoutingProtocol> ();
+        NS_ASSERT_MSG (dvhop, "DV-Hop not installed on node");
+        dvhop->TraceConnectWithoutContext ("TableUpdate", MakeCallback (&DVHopConvergenceMonitor::TableUpdated, this));
+        dvhop->TraceConnectWithoutContext ("HopSize", MakeCallback (&DVHopConvergenceMonitor::HopSizeUpdated, this));
+      }
+  }
+
+  void
+  DVHopConvergenceMonitor::TableUpdated (Ipv4Address, uint16_t, uint16_t)
+  {
+    Changed ();
+  }
+
+  void
+  DVHopConvergenceMonitor::HopSizeUpdated (Ipv4Address, double, uint16_t)
+  {
+    //Localization also waits for the hop sizes flooded once the tables settled
+    Changed ();
+  }
+
+  void
+  DVHopConvergenceMonitor::Changed ()
+  {
+    m_lastChange = Simulator::Now ();
+    m_converged = false;
+    //The pending check moves itself forward, a change only arms it when idle
+    if (!m_check.IsRunning ())
+      {
+        m_check = Simulator::Schedule (m_quietPeriod, &DVHopConvergenceMonitor::Check, this);
+      }
+  }
+
+  void
+  DVHopConvergenceMonitor::Check ()
+  {
+    Time quietUntil = m_lastChange + m_quietPeriod;
+    if (Simulator::Now () < quietUntil)
+      {
+        m_check = Simulator::Schedule (quietUntil - Simulator::Now (), &DVHopConvergenceMonitor::Check, this);
+        return;
+      }
+
+    NS_LOG_INFO ("Tables and hop sizes converged at " << m_lastChange.GetSeconds () << " s");
+    m_converged = true;
+    if (m_convergedCallback.IsNull ())
+      {
+        Simulator::Stop ();
+      }
+    else
+      {
+        m_convergedCallback ();
+      }
+  }
+
+}
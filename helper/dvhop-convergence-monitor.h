@@ -0,0 +1,63 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef DVHOP_CONVERGENCE_MONITOR_H
+#define DVHOP_CONVERGENCE_MONITOR_H
+
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/node-container.h"
+
+namespace ns3 {
+
+  /**
+   *Detects when the distance tables and hop sizes of all nodes stopped changing.
+   *
+   *The monitor listens to the TableUpdate and HopSize traces of every node and keeps a single
+   *check event pending: when it fires, either the quiet period elapsed since the last
+   *change, or it is moved to the end of the new quiet period. Nothing is polled per node.
+   *The monitor must outlive the simulation.
+   */
+  class DVHopConvergenceMonitor
+  {
+  public:
+    DVHopConvergenceMonitor();
+
+    /**
+     *Listens to the table changes of every node of the container
+     */
+    void Install (NodeContainer c);
+
+    /**
+     *Time without table or hop size changes after which the network is considered converged. The beacons
+     *only compute their hop size HopSizeHoldTime after their last table change, so it must be longer than
+     *that plus a HELLO interval, or the simulation may stop before any node has a hop size
+     */
+    void SetQuietPeriod (Time quietPeriod)   { m_quietPeriod = quietPeriod; }
+    Time GetQuietPeriod () const             { return m_quietPeriod; }
+
+    /**
+     *Called once on convergence, Simulator::Stop is called instead if it is null
+     */
+    void SetConvergedCallback (Callback<void> cb) { m_convergedCallback = cb; }
+
+    bool IsConverged () const                { return m_converged; }
+    //Time of the last table or hop size change seen on any node, the convergence time once converged
+    Time GetLastChange () const              { return m_lastChange; }
+
+  private:
+    void TableUpdated (Ipv4Address beacon, uint16_t oldHops, uint16_t newHops);
+    void HopSizeUpdated (Ipv4Address beacon, double hopSize, uint16_t hops);
+    void Changed ();
+    void Check ();
+
+    Time            m_quietPeriod;
+    Time            m_lastChange;
+    bool            m_converged;
+    EventId         m_check;
+    Callback<void>  m_convergedCallback;
+  };
+
+}
+
+#endif /* DVHOP_CONVERGENCE_MONITOR_H */
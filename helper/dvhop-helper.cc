@@ -9,12 +9,96 @@
 #include "ns3/node.h"
 #include "ns3/simulator.h"
 #include "ns3/dvhop.h"
+#include "ns3/localizer.h"
+#include "ns3/distance-snapshot.h"
+#include "ns3/mobility-model.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
 
 namespace ns3 {
 
+  namespace
+  {
+    //What a worker needs from a node, copied before the threads start
+    struct NodeSnapshot
+    {
+      uint32_t            nodeId;
+      bool                hasHopSize;
+      double              hopSize;
+      Vector              position;
+      dvhop::DistanceTable table;
+    };
+
+    void
+    LocalizeRange (std::vector<NodeSnapshot> const &snapshots, uint32_t maxBeacons,
+                   size_t begin, size_t end, std::vector<DVHopLocalization> &results)
+    {
+      //Each worker has its own Localizer, so the cache is never shared
+      dvhop::Localizer localizer;
+      localizer.SetMaxBeacons (maxBeacons);
+      for (size_t i = begin; i < end; i++)
+        {
+          NodeSnapshot const &snapshot = snapshots[i];
+          DVHopLocalization &result = results[i];
+          result.nodeId = snapshot.nodeId;
+          result.localized = false;
+          result.x = 0;
+          result.y = 0;
+          result.error = 0;
+
+          dvhop::Position estimate;
+          if (!snapshot.hasHopSize || !localizer.Localize (snapshot.table, snapshot.hopSize, estimate))
+            {
+              continue;
+            }
+          double dx = estimate.first - snapshot.position.x;
+          double dy = estimate.second - snapshot.position.y;
+          result.localized = true;
+          result.x = estimate.first;
+          result.y = estimate.second;
+          result.error = std::sqrt (dx * dx + dy * dy);
+        }
+    }
+
+    typedef std::vector<std::pair<uint32_t, Ptr<dvhop::RoutingProtocol> > > ProtocolList;
+
+    //The protocol of every node of the container, sorted by node id as the snapshots are
+    ProtocolList
+    SortedProtocols (NodeContainer c)
+    {
+      ProtocolList nodes;
+      nodes.reserve (c.GetN ());
+      for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+        {
+          Ptr<dvhop::RoutingProtocol> rp = (*i)->GetObject<dvhop::RoutingProtocol> ();
+          if (rp)
+            {
+              nodes.push_back (std::make_pair ((*i)->GetId (), rp));
+            }
+        }
+      std::sort (nodes.begin (), nodes.end ());
+      return nodes;
+    }
+
+    //FNV-1a, 32 bits
+    void
+    HashBytes (uint32_t &hash, void const *data, size_t size)
+    {
+      uint8_t const *bytes = static_cast<uint8_t const *> (data);
+      for (size_t i = 0; i < size; i++)
+        {
+          hash ^= bytes[i];
+          hash *= 16777619u;
+        }
+    }
+  }
+
   DVHopHelper::DVHopHelper():Ipv4RoutingHelper()
   {
     m_agentFactory.SetTypeId ("ns3::dvhop::RoutingProtocol");
+    m_locations = ns3::Create<dvhop::LocationRegistry> ();
   }
 
   DVHopHelper*
@@ -27,6 +111,7 @@ namespace ns3 {
   DVHopHelper::Create (Ptr<Node> node) const
   {
     Ptr<dvhop::RoutingProtocol> agent = m_agentFactory.Create<dvhop::RoutingProtocol> ();
+    agent->SetLocationRegistry (m_locations);
     node->AggregateObject (agent);
     return agent;
   }
@@ -61,25 +146,304 @@ namespace ns3 {
 
 
 
+  std::vector<dvhop::Statistics>
+  DVHopHelper::CollectStatistics (NodeContainer c)
+  {
+    std::vector<dvhop::Statistics> stats;
+    stats.reserve (c.GetN ());
+    for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        Ptr<dvhop::RoutingProtocol> dvhop = (*i)->GetObject<dvhop::RoutingProtocol> ();
+        NS_ASSERT_MSG (dvhop, "DV-Hop not installed on node");
+        stats.push_back (dvhop->GetStatistics ());
+      }
+    return stats;
+  }
+
+  void
+  DVHopHelper::WriteStatistics (NodeContainer c, Ptr<OutputStreamWrapper> stream, bool json)
+  {
+    std::vector<dvhop::Statistics> stats = CollectStatistics (c);
+    std::ostream *os = stream->GetStream ();
+    if (json)
+      {
+        *os << "[" << std::endl;
+      }
+    else
+      {
+        *os << "time,node,helloTx,bytesTx,helloRx,bytesRx,entriesAdvertised,updatesApplied,updatesIgnored,lastTableChange,tableSize" << std::endl;
+      }
+
+    double now = Simulator::Now ().GetSeconds ();
+    for (uint32_t i = 0; i < stats.size (); i++)
+      {
+        dvhop::Statistics const &s = stats[i];
+        uint32_t nodeId = c.Get (i)->GetId ();
+        if (json)
+          {
+            *os << "  {\"time\": " << now
+                << ", \"node\": " << nodeId
+                << ", \"helloTx\": " << s.helloTx
+                << ", \"bytesTx\": " << s.bytesTx
+                << ", \"helloRx\": " << s.helloRx
+                << ", \"bytesRx\": " << s.bytesRx
+                << ", \"entriesAdvertised\": " << s.entriesAdvertised
+                << ", \"updatesApplied\": " << s.updatesApplied
+                << ", \"updatesIgnored\": " << s.updatesIgnored
+                << ", \"lastTableChange\": " << s.lastTableChange.GetSeconds ()
+                << ", \"tableSize\": " << s.tableSize
+                << "}" << (i + 1 < stats.size () ? "," : "") << std::endl;
+          }
+        else
+          {
+            *os << now << "," << nodeId << "," << s.helloTx << "," << s.bytesTx << ","
+                << s.helloRx << "," << s.bytesRx << "," << s.entriesAdvertised << ","
+                << s.updatesApplied << "," << s.updatesIgnored << ","
+                << s.lastTableChange.GetSeconds () << "," << s.tableSize << std::endl;
+          }
+      }
+
+    if (json)
+      {
+        *os << "]" << std::endl;
+      }
+  }
+
+  void
+  DVHopHelper::WriteStatisticsAllAt (Time printTime, Ptr<OutputStreamWrapper> stream, bool json) const
+  {
+    Simulator::Schedule (printTime, &DVHopHelper::WriteStatistics, NodeContainer::GetGlobal (), stream, json);
+  }
+
+  std::vector<DVHopLocalization>
+  DVHopHelper::Localize (NodeContainer c, uint32_t threads, uint32_t maxBeacons)
+  {
+    //ns-3 objects are not thread safe, take everything the workers need here
+    std::vector<NodeSnapshot> snapshots;
+    snapshots.reserve (c.GetN ());
+    for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        Ptr<dvhop::RoutingProtocol> dvhop = (*i)->GetObject<dvhop::RoutingProtocol> ();
+        Ptr<MobilityModel> mobility = (*i)->GetObject<MobilityModel> ();
+        NS_ASSERT_MSG (dvhop, "DV-Hop not installed on node");
+        NS_ASSERT_MSG (mobility, "Mobility not installed on node");
+        if (dvhop->IsBeacon ())
+          {
+            continue;
+          }
+        snapshots.push_back (NodeSnapshot ());
+        NodeSnapshot &snapshot = snapshots.back ();
+        snapshot.nodeId = (*i)->GetId ();
+        snapshot.hasHopSize = dvhop->HasHopSize ();
+        snapshot.hopSize = dvhop->GetHopSize ();
+        snapshot.position = mobility->GetPosition ();
+        snapshot.table = dvhop->GetDistanceTable ();
+      }
+
+    std::vector<DVHopLocalization> results (snapshots.size ());
+    if (threads == 0)
+      {
+        threads = std::max (1u, std::thread::hardware_concurrency ());
+      }
+    threads = std::min<size_t> (threads, std::max<size_t> (1, snapshots.size ()));
+
+    //Contiguous ranges, every node is solved the same way whatever thread gets it
+    size_t chunk = (snapshots.size () + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (uint32_t t = 1; t < threads; t++)
+      {
+        size_t begin = std::min (snapshots.size (), t * chunk);
+        size_t end = std::min (snapshots.size (), begin + chunk);
+        workers.push_back (std::thread (LocalizeRange, std::cref (snapshots), maxBeacons, begin, end, std::ref (results)));
+      }
+    LocalizeRange (snapshots, maxBeacons, 0, std::min (snapshots.size (), chunk), results);
+    for (size_t t = 0; t < workers.size (); t++)
+      {
+        workers[t].join ();
+      }
+    return results;
+  }
+
+  DVHopLocalizationSummary
+  DVHopHelper::Summarize (std::vector<DVHopLocalization> const &results)
+  {
+    DVHopLocalizationSummary summary;
+    summary.nodes = results.size ();
+    summary.localized = 0;
+    summary.meanError = 0;
+    summary.rmsError = 0;
+    summary.maxError = 0;
+
+    //Serial and in node order, so the sums are reproducible
+    double sumSquares = 0;
+    for (size_t i = 0; i < results.size (); i++)
+      {
+        if (!results[i].localized)
+          {
+            continue;
+          }
+        summary.localized++;
+        summary.meanError += results[i].error;
+        sumSquares += results[i].error * results[i].error;
+        summary.maxError = std::max (summary.maxError, results[i].error);
+      }
+    if (summary.localized > 0)
+      {
+        summary.meanError /= summary.localized;
+        summary.rmsError = std::sqrt (sumSquares / summary.localized);
+      }
+    return summary;
+  }
+
   void
   DVHopHelper::PrintDistanceTableAllAt(Time printTime, Ptr<OutputStreamWrapper> stream) const
   {
-    for(uint32_t i=0; i < NodeList::GetNNodes (); i++)
+    Simulator::Schedule (printTime, &DVHopHelper::PrintDistanceTables, NodeContainer::GetGlobal (), stream);
+  }
+
+  void
+  DVHopHelper::PrintDistanceTables (NodeContainer c, Ptr<OutputStreamWrapper> stream)
+  {
+    for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+      {
+        Ptr<dvhop::RoutingProtocol> rp = (*i)->GetObject<dvhop::RoutingProtocol> ();
+        if (rp)
+          {
+            rp->PrintDistances (stream, *i);
+          }
+      }
+  }
+
+  bool
+  DVHopHelper::WriteSnapshot (NodeContainer c, std::string filename)
+  {
+    //Records must be sorted by node id, whatever the container order
+    ProtocolList nodes = SortedProtocols (c);
+
+    dvhop::SnapshotWriter writer;
+    if (!writer.Open (filename, Simulator::Now ()))
+      {
+        return false;
+      }
+    writer.SetTopology (HashTopology (c));
+    for (size_t i = 0; i < nodes.size (); i++)
+      {
+        Ptr<dvhop::RoutingProtocol> rp = nodes[i].second;
+        dvhop::SnapshotNode state;
+        std::memset (&state, 0, sizeof (state));
+        state.node = nodes[i].first;
+        state.seqNo = rp->GetSequenceNumber ();
+        state.posVersion = rp->GetPositionVersion ();
+        state.flags = rp->IsBeacon () ? dvhop::SnapshotNode::BEACON : 0;
+        if (rp->HasHopSize ())
+          {
+            state.flags |= dvhop::SnapshotNode::HAS_HOP_SIZE;
+            state.hopSize = rp->GetHopSize ();
+            state.hopSizeBeacon = rp->GetHopSizeBeacon ().Get ();
+            state.hopSizeHops = rp->GetHopSizeHops ();
+            state.hopSizeSeqNo = rp->GetHopSizeSeqNo ();
+          }
+        writer.AddTable (state, rp->GetDistanceTable ());
+      }
+    return writer.Close ();
+  }
+
+  uint32_t
+  DVHopHelper::HashTopology (NodeContainer c)
+  {
+    ProtocolList nodes = SortedProtocols (c);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < nodes.size (); i++)
       {
-        Ptr<Node> node = NodeList::GetNode (i);
-        Simulator::Schedule(printTime, &DVHopHelper::Print, this, node, stream);
+        Ptr<dvhop::RoutingProtocol> rp = nodes[i].second;
+        uint8_t beacon = rp->IsBeacon ();
+        HashBytes (hash, &nodes[i].first, sizeof (nodes[i].first));
+        HashBytes (hash, &beacon, sizeof (beacon));
+
+        //Positions to the millimeter, so a rerun of the same scenario matches
+        Ptr<MobilityModel> mobility = rp->GetObject<MobilityModel> ();
+        if (mobility)
+          {
+            Vector position = mobility->GetPosition ();
+            int64_t mm[2] = { std::llround (position.x * 1000), std::llround (position.y * 1000) };
+            HashBytes (hash, mm, sizeof (mm));
+          }
+
+        Ptr<Ipv4> ipv4 = rp->GetIpv4 ();
+        for (uint32_t j = 0; ipv4 && j < ipv4->GetNInterfaces (); j++)
+          {
+            for (uint32_t k = 0; k < ipv4->GetNAddresses (j); k++)
+              {
+                Ipv4Address local = ipv4->GetAddress (j, k).GetLocal ();
+                if (local.IsLocalhost ())
+                  {
+                    continue;
+                  }
+                uint32_t address = local.Get ();
+                HashBytes (hash, &address, sizeof (address));
+              }
+          }
       }
+    return hash;
+  }
 
+  bool
+  DVHopHelper::LoadSnapshot (NodeContainer c, std::string filename)
+  {
+    dvhop::SnapshotReader reader;
+    if (!reader.Open (filename))
+      {
+        return false;
+      }
+    ProtocolList nodes = SortedProtocols (c);
+    if (reader.GetHeader ().nodes != nodes.size () || reader.GetHeader ().topology != HashTopology (c))
+      {
+        //Tables of another network would route and localize nonsense
+        return false;
+      }
+    for (size_t i = 0; i < nodes.size (); i++)
+      {
+        dvhop::SnapshotNode const *state = reader.FindNodeState (nodes[i].first);
+        if (!state)
+          {
+            return false;
+          }
+        if (((state->flags & dvhop::SnapshotNode::BEACON) != 0) != nodes[i].second->IsBeacon ())
+          {
+            //A beacon restored as an ordinary node, or the reverse, would advertise the wrong entries
+            return false;
+          }
+      }
+
+    for (size_t i = 0; i < nodes.size (); i++)
+      {
+        dvhop::SnapshotRecord const *begin;
+        dvhop::SnapshotRecord const *end;
+        reader.FindNode (nodes[i].first, begin, end);
+        dvhop::DistanceTable table;
+        for (dvhop::SnapshotRecord const *r = begin; r != end; ++r)
+          {
+            table.AddBeacon (Ipv4Address (r->beacon), r->hops, r->x, r->y, r->seqNo, r->posVersion,
+                             Ipv4Address (r->nextHop), r->interface);
+          }
+        nodes[i].second->WarmStart (table, *reader.FindNodeState (nodes[i].first));
+      }
+    return true;
   }
 
   void
-  DVHopHelper::Print (Ptr<Node> node, Ptr<OutputStreamWrapper> stream) const
+  DVHopHelper::WriteSnapshotAllAt (Time printTime, std::string filename) const
   {
-    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-    Ptr<dvhop::RoutingProtocol> rp = DynamicCast<dvhop::RoutingProtocol>(ipv4->GetRoutingProtocol ());
-    //Ptr<Ipv4RoutingProtocol> rp = ipv4->GetRoutingProtocol ();
-    NS_ASSERT (rp);
-    rp->PrintDistances(stream, node);
+    Simulator::Schedule (printTime, &DVHopHelper::WriteSnapshotEvent, NodeContainer::GetGlobal (), filename);
+  }
+
+  void
+  DVHopHelper::WriteSnapshotEvent (NodeContainer c, std::string filename)
+  {
+    if (!WriteSnapshot (c, filename))
+      {
+        NS_FATAL_ERROR ("Could not write the DV-Hop snapshot " << filename);
+      }
   }
 
 }
@@ -8,6 +8,8 @@
 #include "ns3/node-container.h"
 #include "ns3/output-stream-wrapper.h"
 #include "ns3/ipv4-list-routing.h"
+#include "ns3/dvhop.h"
+#include <vector>
 
 namespace ns3 {
 
@@ -16,6 +18,33 @@ namespace ns3 {
   class Ipv4RoutingProtocol;
 
 
+  /**
+   *Position estimated for a node by DVHopHelper::Localize
+   */
+  struct DVHopLocalization
+  {
+    uint32_t nodeId;
+    //False if the node knows less than 3 beacons, has no hop size or the beacons are collinear
+    bool     localized;
+    double   x;
+    double   y;
+    //Distance between the estimate and the position given by the node MobilityModel
+    double   error;
+  };
+
+  /**
+   *Error statistics over the results of DVHopHelper::Localize
+   */
+  struct DVHopLocalizationSummary
+  {
+    uint32_t nodes;
+    uint32_t localized;
+    double   meanError;
+    double   rmsError;
+    double   maxError;
+  };
+
+
   class DVHopHelper : public Ipv4RoutingHelper
   {
   public:
@@ -42,15 +71,82 @@ namespace ns3 {
     int64_t  AssignStreams(NodeContainer c, int64_t stream);
 
     /**
-     *Print the distance table to each reference at a given time
+     *Print the distance table of every node as text at a given time, from a single event
      */
     void PrintDistanceTableAllAt (Time printTime, Ptr<OutputStreamWrapper> stream) const;
 
+    /**
+     *Print the distance table of every node of the container as text
+     */
+    static void PrintDistanceTables (NodeContainer c, Ptr<OutputStreamWrapper> stream);
+
+    /**
+     *Streams the distance tables of every node of the container to a binary snapshot file,
+     *see dvhop::SnapshotWriter. Much smaller and faster than the text dump on large networks.
+     *Returns false if the file could not be written
+     */
+    static bool WriteSnapshot (NodeContainer c, std::string filename);
+
+    /**
+     *Restores every node of the container from a snapshot written by WriteSnapshot on the same
+     *topology, so the nodes start localized instead of flooding their tables again. Call it once the
+     *stack is installed, the addresses assigned and the beacons set. Returns false, changing nothing,
+     *if the file can not be read or was written for other nodes, addresses, positions or beacons
+     */
+    static bool LoadSnapshot (NodeContainer c, std::string filename);
+
+    /**
+     *Hash of the node ids, beacon roles, positions and addresses of the container, stored in the
+     *snapshots to check a warm start runs on the topology the tables were built on
+     */
+    static uint32_t HashTopology (NodeContainer c);
+
+    /**
+     *Writes a snapshot of every node at a given time, from a single event
+     */
+    void WriteSnapshotAllAt (Time printTime, std::string filename) const;
+
+    /**
+     *Collects the protocol counters of every node of the container, in container order
+     */
+    static std::vector<dvhop::Statistics> CollectStatistics (NodeContainer c);
+
+    /**
+     *Writes the protocol counters of every node of the container, as CSV with a header line or as a JSON array
+     */
+    static void WriteStatistics (NodeContainer c, Ptr<OutputStreamWrapper> stream, bool json = false);
+
+    /**
+     *Writes the protocol counters of every node at a given time
+     */
+    void WriteStatisticsAllAt (Time printTime, Ptr<OutputStreamWrapper> stream, bool json = false) const;
+
+    /**
+     *Localizes every non beacon node of the container with the distance table and hop size it holds now,
+     *typically once Simulator::Run returns. The tables are copied on the calling thread and solved by up to
+     *threads workers (0 uses the hardware concurrency). Results follow the container order and do not
+     *depend on the number of threads. maxBeacons limits each node to its closest beacons, 0 uses all.
+     */
+    static std::vector<DVHopLocalization> Localize (NodeContainer c, uint32_t threads = 0, uint32_t maxBeacons = 0);
+
+    /**
+     *Error statistics of the localized nodes, accumulated in node order
+     */
+    static DVHopLocalizationSummary Summarize (std::vector<DVHopLocalization> const &results);
+
+    /**
+     *The registry shared by every node created by this helper and its copies, where the nodes
+     *publish their positions and look up the destinations when GeographicForwarding is enabled
+     */
+    Ptr<dvhop::LocationRegistry> GetLocationRegistry () const { return m_locations; }
+
   private:
-    void Print (Ptr<Node> node, Ptr<OutputStreamWrapper> stream) const;
+    //Scheduled by WriteSnapshotAllAt, events can not return a value
+    static void WriteSnapshotEvent (NodeContainer c, std::string filename);
 
     /*The factory to create DVHope Routing object*/
     ObjectFactory m_agentFactory;
+    Ptr<dvhop::LocationRegistry> m_locations;
   };
 
 }
@@ -0,0 +1,251 @@
+#include "batch-localizer.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DVHOP_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    /*
+     * With r_i = s * h_i the least-squares estimate of a node is
+     *   x = x_n + Σ mx_j k_j + s² (h_n² Σ mx_j - Σ mx_j h_j²)
+     * so the per-node work is one multiply-add per beacon and coordinate,
+     * once the sums that only depend on the beacons are folded in x0 and sumMx.
+     */
+    namespace
+    {
+      struct Terms
+      {
+        uint32_t      n;
+        double const *mx;
+        double const *my;
+        double        sumMx;
+        double        sumMy;
+        double        x0;
+        double        y0;
+      };
+
+      void
+      LocalizeScalar (Terms const &t, uint32_t nodes, uint32_t begin,
+                      uint16_t const *hops, double const *hopSizes, double *x, double *y)
+      {
+        uint16_t const *ref = hops + (size_t) t.n * nodes;
+        for (uint32_t i = begin; i < nodes; i++)
+          {
+            double hn = ref[i];
+            double ax = hn * hn * t.sumMx;
+            double ay = hn * hn * t.sumMy;
+            for (uint32_t j = 0; j < t.n; j++)
+              {
+                double h = hops[(size_t) j * nodes + i];
+                ax -= t.mx[j] * h * h;
+                ay -= t.my[j] * h * h;
+              }
+            double s2 = hopSizes[i] * hopSizes[i];
+            x[i] = t.x0 + s2 * ax;
+            y[i] = t.y0 + s2 * ay;
+          }
+      }
+
+#ifdef DVHOP_X86_KERNELS
+      __attribute__ ((target ("sse2"))) inline __m128d
+      Load2 (uint16_t const *p)
+      {
+        int32_t packed;
+        std::memcpy (&packed, p, sizeof (packed));
+        __m128i v = _mm_unpacklo_epi16 (_mm_cvtsi32_si128 (packed), _mm_setzero_si128 ());
+        return _mm_cvtepi32_pd (v);
+      }
+
+      __attribute__ ((target ("sse2"))) void
+      LocalizeSse2 (Terms const &t, uint32_t nodes,
+                    uint16_t const *hops, double const *hopSizes, double *x, double *y)
+      {
+        uint16_t const *ref = hops + (size_t) t.n * nodes;
+        __m128d sumMx = _mm_set1_pd (t.sumMx);
+        __m128d sumMy = _mm_set1_pd (t.sumMy);
+        __m128d x0 = _mm_set1_pd (t.x0);
+        __m128d y0 = _mm_set1_pd (t.y0);
+        uint32_t i = 0;
+        for (; i + 2 <= nodes; i += 2)
+          {
+            __m128d hn = Load2 (ref + i);
+            __m128d hn2 = _mm_mul_pd (hn, hn);
+            __m128d ax = _mm_mul_pd (hn2, sumMx);
+            __m128d ay = _mm_mul_pd (hn2, sumMy);
+            for (uint32_t j = 0; j < t.n; j++)
+              {
+                __m128d h = Load2 (hops + (size_t) j * nodes + i);
+                __m128d h2 = _mm_mul_pd (h, h);
+                ax = _mm_sub_pd (ax, _mm_mul_pd (_mm_set1_pd (t.mx[j]), h2));
+                ay = _mm_sub_pd (ay, _mm_mul_pd (_mm_set1_pd (t.my[j]), h2));
+              }
+            __m128d s = _mm_loadu_pd (hopSizes + i);
+            __m128d s2 = _mm_mul_pd (s, s);
+            _mm_storeu_pd (x + i, _mm_add_pd (x0, _mm_mul_pd (s2, ax)));
+            _mm_storeu_pd (y + i, _mm_add_pd (y0, _mm_mul_pd (s2, ay)));
+          }
+        LocalizeScalar (t, nodes, i, hops, hopSizes, x, y);
+      }
+
+      __attribute__ ((target ("avx2,fma"))) inline __m256d
+      Load4 (uint16_t const *p)
+      {
+        __m128i v = _mm_loadl_epi64 (reinterpret_cast<__m128i const *> (p));
+        return _mm256_cvtepi32_pd (_mm_cvtepu16_epi32 (v));
+      }
+
+      __attribute__ ((target ("avx2,fma"))) void
+      LocalizeAvx2 (Terms const &t, uint32_t nodes,
+                    uint16_t const *hops, double const *hopSizes, double *x, double *y)
+      {
+        uint16_t const *ref = hops + (size_t) t.n * nodes;
+        __m256d sumMx = _mm256_set1_pd (t.sumMx);
+        __m256d sumMy = _mm256_set1_pd (t.sumMy);
+        __m256d x0 = _mm256_set1_pd (t.x0);
+        __m256d y0 = _mm256_set1_pd (t.y0);
+        uint32_t i = 0;
+        for (; i + 4 <= nodes; i += 4)
+          {
+            __m256d hn = Load4 (ref + i);
+            __m256d hn2 = _mm256_mul_pd (hn, hn);
+            __m256d ax = _mm256_mul_pd (hn2, sumMx);
+            __m256d ay = _mm256_mul_pd (hn2, sumMy);
+            for (uint32_t j = 0; j < t.n; j++)
+              {
+                __m256d h = Load4 (hops + (size_t) j * nodes + i);
+                __m256d h2 = _mm256_mul_pd (h, h);
+                ax = _mm256_fnmadd_pd (_mm256_set1_pd (t.mx[j]), h2, ax);
+                ay = _mm256_fnmadd_pd (_mm256_set1_pd (t.my[j]), h2, ay);
+              }
+            __m256d s = _mm256_loadu_pd (hopSizes + i);
+            __m256d s2 = _mm256_mul_pd (s, s);
+            _mm256_storeu_pd (x + i, _mm256_fmadd_pd (s2, ax, x0));
+            _mm256_storeu_pd (y + i, _mm256_fmadd_pd (s2, ay, y0));
+          }
+        LocalizeScalar (t, nodes, i, hops, hopSizes, x, y);
+      }
+#endif
+    }
+
+
+    BatchLocalizer::BatchLocalizer()
+      : m_kernel (SCALAR),
+        m_beacons (0),
+        m_sumMx (0),
+        m_sumMy (0),
+        m_x0 (0),
+        m_y0 (0)
+    {
+      m_solver.valid = false;
+      if (IsSupported (AVX2))
+        {
+          m_kernel = AVX2;
+        }
+      else if (IsSupported (SSE2))
+        {
+          m_kernel = SSE2;
+        }
+    }
+
+    bool
+    BatchLocalizer::SetBeacons (std::vector<double> const &x, std::vector<double> const &y)
+    {
+      std::vector<Position> beacons;
+      for (size_t i = 0; i < x.size () && i < y.size (); i++)
+        {
+          beacons.push_back (Position (x[i], y[i]));
+        }
+      m_beacons = beacons.size ();
+      m_solver.valid = false;
+      if (m_beacons < 3)
+        {
+          return false;
+        }
+
+      Localizer::BuildSolver (beacons, m_solver);
+      if (!m_solver.valid)
+        {
+          return false;
+        }
+
+      m_sumMx = 0;
+      m_sumMy = 0;
+      m_x0 = beacons.back ().first;
+      m_y0 = beacons.back ().second;
+      for (size_t j = 0; j < m_solver.k.size (); j++)
+        {
+          m_sumMx += m_solver.mx[j];
+          m_sumMy += m_solver.my[j];
+          m_x0 += m_solver.mx[j] * m_solver.k[j];
+          m_y0 += m_solver.my[j] * m_solver.k[j];
+        }
+      return true;
+    }
+
+    bool
+    BatchLocalizer::Localize (uint32_t nodes, uint16_t const *hops, double const *hopSizes, double *x, double *y) const
+    {
+      if (!m_solver.valid)
+        {
+          return false;
+        }
+
+      Terms t;
+      t.n = m_beacons - 1;
+      t.mx = &m_solver.mx[0];
+      t.my = &m_solver.my[0];
+      t.sumMx = m_sumMx;
+      t.sumMy = m_sumMy;
+      t.x0 = m_x0;
+      t.y0 = m_y0;
+
+      switch (m_kernel)
+        {
+#ifdef DVHOP_X86_KERNELS
+        case AVX2:
+          LocalizeAvx2 (t, nodes, hops, hopSizes, x, y);
+          break;
+        case SSE2:
+          LocalizeSse2 (t, nodes, hops, hopSizes, x, y);
+          break;
+#endif
+        default:
+          LocalizeScalar (t, nodes, 0, hops, hopSizes, x, y);
+          break;
+        }
+      return true;
+    }
+
+    void
+    BatchLocalizer::SetKernel (Kernel kernel)
+    {
+      m_kernel = IsSupported (kernel) ? kernel : SCALAR;
+    }
+
+    bool
+    BatchLocalizer::IsSupported (Kernel kernel)
+    {
+      switch (kernel)
+        {
+        case SCALAR:
+          return true;
+#ifdef DVHOP_X86_KERNELS
+        case SSE2:
+          return __builtin_cpu_supports ("sse2");
+        case AVX2:
+          return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+#endif
+        default:
+          return false;
+        }
+    }
+
+
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef BATCHLOCALIZER_H
+#define BATCHLOCALIZER_H
+
+#include <vector>
+#include "localizer.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+
+    /**
+     * @brief The BatchLocalizer class localizes many nodes that know the same beacons at once.
+     *
+     * Inputs are structure-of-arrays: the hop counts are stored beacon-major, so
+     * the kernels load the hops of several consecutive nodes to the same beacon
+     * with a single vector load. The AVX2 or SSE2 kernel is picked at run time
+     * from the CPU features, with a portable scalar fallback.
+     */
+    class BatchLocalizer
+    {
+    public:
+      enum Kernel
+      {
+        SCALAR,
+        SSE2,
+        AVX2
+      };
+
+      BatchLocalizer();
+
+      /**
+       * @brief SetBeacons Sets the beacons shared by every node of the batch
+       * @param x The X coordinate of each beacon
+       * @param y The Y coordinate of each beacon
+       * @return False if there are less than 3 beacons or they are collinear
+       */
+      bool SetBeacons(std::vector<double> const &x, std::vector<double> const &y);
+      uint32_t GetBeaconCount() const { return m_beacons; }
+
+      /**
+       * @brief Localize Estimates the position of every node of the batch
+       * @param nodes The number of nodes
+       * @param hops Beacon-major hop counts, hops[j * nodes + i] is the hop count of node i to beacon j
+       * @param hopSizes The hop size of each node
+       * @param x Set to the estimated X coordinate of each node
+       * @param y Set to the estimated Y coordinate of each node
+       * @return False if the beacons are not usable
+       */
+      bool Localize(uint32_t nodes, uint16_t const *hops, double const *hopSizes, double *x, double *y) const;
+
+      //The kernel used by Localize, defaults to the best one supported by the CPU
+      void    SetKernel(Kernel kernel);
+      Kernel  GetKernel() const { return m_kernel; }
+
+      /**
+       * @brief IsSupported Whether the CPU running the simulation supports a kernel
+       * @param kernel The kernel
+       * @return True if the kernel can be used
+       */
+      static bool IsSupported(Kernel kernel);
+
+    private:
+      Kernel            m_kernel;
+      uint32_t          m_beacons;
+      Localizer::Solver m_solver;
+      //Terms folded over the beacons, see batch-localizer.cc
+      double            m_sumMx;
+      double            m_sumMy;
+      double            m_x0;
+      double            m_y0;
+    };
+
+
+  }
+}
+
+#endif // BATCHLOCALIZER_H
@@ -0,0 +1,230 @@
+#include "distance-snapshot.h"
+#include "ns3/fatal-error.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    namespace
+    {
+      //Records buffered before a write
+      const size_t CHUNK_RECORDS = 65536;
+      const char   MAGIC[4] = { 'D', 'V', 'H', 'S' };
+
+      struct NodeBefore
+      {
+        bool operator() (SnapshotRecord const &r, uint32_t node) const { return r.node < node; }
+        bool operator() (uint32_t node, SnapshotRecord const &r) const { return node < r.node; }
+        bool operator() (SnapshotNode const &n, uint32_t node) const   { return n.node < node; }
+      };
+    }
+
+
+    //The layout documented in distance-snapshot.h, without padding
+    static_assert (sizeof (SnapshotHeader) == 32, "Unexpected snapshot header size");
+    static_assert (sizeof (SnapshotRecord) == 48, "Unexpected snapshot record size");
+    static_assert (sizeof (SnapshotNode) == 24, "Unexpected snapshot node size");
+
+    const uint8_t  SnapshotNode::BEACON;
+    const uint8_t  SnapshotNode::HAS_HOP_SIZE;
+    const uint16_t SnapshotWriter::VERSION = 2;
+
+    SnapshotWriter::SnapshotWriter()
+    {
+      std::memset (&m_header, 0, sizeof (m_header));
+    }
+
+    SnapshotWriter::~SnapshotWriter()
+    {
+      if (m_file.is_open ())
+        {
+          Close ();
+        }
+    }
+
+    bool
+    SnapshotWriter::Open (std::string const &filename, Time time)
+    {
+      m_file.open (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+      std::memset (&m_header, 0, sizeof (m_header));
+      std::memcpy (m_header.magic, MAGIC, sizeof (MAGIC));
+      m_header.version = VERSION;
+      m_header.recordSize = sizeof (SnapshotRecord);
+      m_header.time = time.GetNanoSeconds ();
+      m_buffer.clear ();
+      m_buffer.reserve (CHUNK_RECORDS);
+      m_nodes.clear ();
+      m_file.write (reinterpret_cast<char const *> (&m_header), sizeof (m_header));
+      return m_file.good ();
+    }
+
+    void
+    SnapshotWriter::AddTable (uint32_t node, DistanceTable const &table)
+    {
+      SnapshotNode state;
+      std::memset (&state, 0, sizeof (state));
+      state.node = node;
+      AddTable (state, table);
+    }
+
+    void
+    SnapshotWriter::AddTable (SnapshotNode const &node, DistanceTable const &table)
+    {
+      //The reader binary searches the records and nodes by id, out of order tables could not be found again
+      if (!m_nodes.empty () && node.node <= m_nodes.back ().node)
+        {
+          NS_FATAL_ERROR ("Snapshot tables must be added by increasing node id, node " << node.node
+                          << " follows node " << m_nodes.back ().node);
+        }
+      m_header.nodes++;
+      m_nodes.push_back (node);
+      for (DistanceTable::Iterator it = table.Begin (); it != table.End (); ++it)
+        {
+          m_buffer.push_back (SnapshotRecord ());
+          SnapshotRecord &r = m_buffer.back ();
+          std::memset (&r, 0, sizeof (r));
+          r.node = node.node;
+          r.beacon = it->first.Get ();
+          r.nextHop = it->second.GetNextHop ().Get ();
+          r.hops = it->second.GetHops ();
+          r.seqNo = it->second.GetSeqNo ();
+          r.interface = it->second.GetInterface ();
+          r.posVersion = it->second.GetPositionVersion ();
+          r.x = it->second.GetPosition ().first;
+          r.y = it->second.GetPosition ().second;
+          r.updatedAt = it->second.GetTime ().GetNanoSeconds ();
+          if (m_buffer.size () == CHUNK_RECORDS)
+            {
+              Flush ();
+            }
+        }
+    }
+
+    void
+    SnapshotWriter::Flush ()
+    {
+      if (m_buffer.empty ())
+        {
+          return;
+        }
+      m_file.write (reinterpret_cast<char const *> (&m_buffer[0]), m_buffer.size () * sizeof (SnapshotRecord));
+      m_header.records += m_buffer.size ();
+      m_buffer.clear ();
+    }
+
+    bool
+    SnapshotWriter::Close ()
+    {
+      Flush ();
+      //The node section follows the records, it is small enough to be kept until now
+      if (!m_nodes.empty ())
+        {
+          m_file.write (reinterpret_cast<char const *> (&m_nodes[0]), m_nodes.size () * sizeof (SnapshotNode));
+        }
+      //The counts are only known now
+      m_file.seekp (0);
+      m_file.write (reinterpret_cast<char const *> (&m_header), sizeof (m_header));
+      bool good = m_file.good ();
+      m_file.close ();
+      return good;
+    }
+
+
+    SnapshotReader::SnapshotReader()
+      : m_map (0),
+        m_size (0),
+        m_header (0),
+        m_records (0),
+        m_nodes (0)
+    {
+    }
+
+    SnapshotReader::~SnapshotReader()
+    {
+      Close ();
+    }
+
+    bool
+    SnapshotReader::Open (std::string const &filename)
+    {
+      Close ();
+      int fd = open (filename.c_str (), O_RDONLY);
+      if (fd < 0)
+        {
+          return false;
+        }
+      struct stat st;
+      if (fstat (fd, &st) != 0 || size_t (st.st_size) < sizeof (SnapshotHeader))
+        {
+          close (fd);
+          return false;
+        }
+      void *map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      //The mapping stays valid once the descriptor is closed
+      close (fd);
+      if (map == MAP_FAILED)
+        {
+          return false;
+        }
+      m_map = map;
+      m_size = st.st_size;
+
+      SnapshotHeader const *header = static_cast<SnapshotHeader const *> (m_map);
+      if (std::memcmp (header->magic, MAGIC, sizeof (MAGIC)) != 0
+          || header->version != SnapshotWriter::VERSION
+          || header->recordSize != sizeof (SnapshotRecord)
+          || header->records > (m_size - sizeof (SnapshotHeader)) / sizeof (SnapshotRecord)
+          || m_size != sizeof (SnapshotHeader) + header->records * sizeof (SnapshotRecord) + uint64_t (header->nodes) * sizeof (SnapshotNode))
+        {
+          Close ();
+          return false;
+        }
+      m_header = header;
+      m_records = reinterpret_cast<SnapshotRecord const *> (static_cast<char const *> (m_map) + sizeof (SnapshotHeader));
+      m_nodes = reinterpret_cast<SnapshotNode const *> (m_records + header->records);
+      return true;
+    }
+
+    void
+    SnapshotReader::Close ()
+    {
+      if (m_map)
+        {
+          munmap (m_map, m_size);
+        }
+      m_map = 0;
+      m_size = 0;
+      m_header = 0;
+      m_records = 0;
+      m_nodes = 0;
+    }
+
+    void
+    SnapshotReader::FindNode (uint32_t node, SnapshotRecord const *&begin, SnapshotRecord const *&end) const
+    {
+      std::pair<SnapshotRecord const *, SnapshotRecord const *> range = std::equal_range (Begin (), End (), node, NodeBefore ());
+      begin = range.first;
+      end = range.second;
+    }
+
+    SnapshotNode const *
+    SnapshotReader::FindNodeState (uint32_t node) const
+    {
+      SnapshotNode const *it = std::lower_bound (BeginNodes (), EndNodes (), node, NodeBefore ());
+      if (it != EndNodes () && it->node == node)
+        {
+          return it;
+        }
+      return 0;
+    }
+
+
+  }
+}
@@ -0,0 +1,200 @@
+#ifndef DISTANCESNAPSHOT_H
+#define DISTANCESNAPSHOT_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ns3/nstime.h"
+#include "distance-table.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+
+    /*
+    Binary snapshot of the distance tables of many nodes, in host byte order:
+
+    0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                         Magic "DVHS"                          |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |           Version             |          Record size          |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                          Node count                           |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                 Topology hash (0 if unknown)                  |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                   Record count (64 bits)                      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |              Simulation time, ns (64 bits)                    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                                                               |
+    ~                   Record count x SnapshotRecord               ~
+    |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                                                               |
+    ~                   Node count x SnapshotNode                   ~
+    |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Records are sorted by node id, then by beacon address, so the table of
+    a node is a contiguous range found by binary search. The node section
+    keeps the rest of the protocol state needed to warm start from the file.
+
+    Versions:
+      1  40 bytes records, no interface nor position version, reserved
+         header word, no node section.
+      2  48 bytes records, topology hash, node section.
+    Readers only accept their own version, older files must be written again.
+    */
+    struct SnapshotHeader
+    {
+      char      magic[4];
+      uint16_t  version;
+      uint16_t  recordSize;
+      uint32_t  nodes;
+      uint32_t  topology;
+      uint64_t  records;
+      int64_t   time;
+    };
+
+    //One distance table entry of one node, fixed width
+    struct SnapshotRecord
+    {
+      uint32_t  node;
+      uint32_t  beacon;      //Beacon address, as returned by Ipv4Address::Get
+      uint32_t  nextHop;
+      uint16_t  hops;
+      uint16_t  seqNo;
+      uint16_t  interface;   //Interface the next hop is reached through
+      uint8_t   posVersion;
+      uint8_t   reserved;
+      uint32_t  reserved2;
+      double    x;
+      double    y;
+      int64_t   updatedAt;   //ns
+    };
+
+    //Protocol state of one node besides its table, fixed width
+    struct SnapshotNode
+    {
+      static const uint8_t BEACON = 0x01;
+      static const uint8_t HAS_HOP_SIZE = 0x02;
+
+      uint32_t  node;
+      uint32_t  hopSizeBeacon;
+      double    hopSize;
+      uint16_t  hopSizeHops;
+      uint16_t  hopSizeSeqNo;
+      uint16_t  seqNo;       //Sequence number of the own beacon entry
+      uint8_t   posVersion;  //Version of the own beacon position
+      uint8_t   flags;
+    };
+
+    /**
+     * @brief The SnapshotWriter class streams distance tables to a snapshot file,
+     *in chunks, without formatting them as text.
+     */
+    class SnapshotWriter
+    {
+    public:
+      static const uint16_t VERSION;
+
+      SnapshotWriter();
+      ~SnapshotWriter();
+
+      /**
+       * @brief Open Creates the file and writes a provisional header
+       * @param filename The snapshot file
+       * @param time The simulation time stored in the header
+       * @return False if the file can not be created
+       */
+      bool Open(std::string const &filename, Time time);
+
+      /**
+       * @brief AddTable Appends the table of a node, nodes must be added by increasing id
+       *and adding one out of order is a fatal error
+       * @param node The node id and the rest of its state
+       * @param table Its distance table
+       */
+      void AddTable(SnapshotNode const &node, DistanceTable const &table);
+      //Without any state besides the table
+      void AddTable(uint32_t node, DistanceTable const &table);
+
+      //Hash of the topology the tables were built on, checked before a warm start
+      void SetTopology(uint32_t topology) { m_header.topology = topology; }
+
+      /**
+       * @brief Close Flushes the pending records and completes the header
+       * @return False if a write failed
+       */
+      bool Close();
+
+    private:
+      void Flush();
+
+      std::ofstream               m_file;
+      SnapshotHeader              m_header;
+      std::vector<SnapshotRecord> m_buffer;
+      std::vector<SnapshotNode>   m_nodes;
+    };
+
+    /**
+     * @brief The SnapshotReader class maps a snapshot file in memory, records are
+     *read in place without parsing.
+     */
+    class SnapshotReader
+    {
+    public:
+      SnapshotReader();
+      ~SnapshotReader();
+
+      /**
+       * @brief Open Maps a snapshot file
+       * @param filename The snapshot file
+       * @return False if the file can not be mapped or is not a snapshot of this version
+       */
+      bool Open(std::string const &filename);
+      void Close();
+
+      SnapshotHeader const & GetHeader() const      { return *m_header; }
+      uint64_t               GetRecordCount() const { return m_header ? m_header->records : 0; }
+      SnapshotRecord const * Begin() const          { return m_records; }
+      SnapshotRecord const * End() const            { return m_records + GetRecordCount (); }
+      SnapshotNode const *   BeginNodes() const     { return m_nodes; }
+      SnapshotNode const *   EndNodes() const       { return m_nodes + (m_header ? m_header->nodes : 0); }
+
+      /**
+       * @brief FindNodeState The state saved for a node
+       * @param node The node id
+       * @return The state, or 0 if the node is not in the snapshot
+       */
+      SnapshotNode const * FindNodeState(uint32_t node) const;
+
+      /**
+       * @brief FindNode The records of a node
+       * @param node The node id
+       * @param begin Set to its first record
+       * @param end Set past its last record, equal to begin if the node has no entries
+       */
+      void FindNode(uint32_t node, SnapshotRecord const *&begin, SnapshotRecord const *&end) const;
+
+    private:
+      SnapshotReader(SnapshotReader const &);
+      SnapshotReader & operator= (SnapshotReader const &);
+
+      void                  *m_map;
+      size_t                 m_size;
+      SnapshotHeader const  *m_header;
+      SnapshotRecord const  *m_records;
+      SnapshotNode const    *m_nodes;
+    };
+
+
+  }
+}
+
+#endif // DISTANCESNAPSHOT_H
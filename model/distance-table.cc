@@ -7,22 +7,89 @@ namespace ns3
   namespace dvhop
   {
 
+    namespace
+    {
+      //Orders the entries by the raw 32 bits of the beacon address
+      struct EntryBefore
+      {
+        bool operator() (DistanceTable::Entry const &entry, uint32_t beacon) const
+        {
+          return entry.first.Get () < beacon;
+        }
+      };
+
+      //Matches the entries not updated after a cutoff time
+      struct ExpiredBefore
+      {
+        explicit ExpiredBefore (Time cutoff) : m_cutoff (cutoff) {}
+        bool operator() (DistanceTable::Entry const &entry) const
+        {
+          return entry.second.GetTime () <= m_cutoff;
+        }
+        Time m_cutoff;
+      };
+    }
+
 
     DistanceTable::DistanceTable()
+      : m_version (0),
+        m_dirtyVersion (0)
+    {
+    }
+
+    std::vector<DistanceTable::Entry>::const_iterator
+    DistanceTable::LowerBound (Ipv4Address beacon) const
+    {
+      return std::lower_bound (m_table.begin (), m_table.end (), beacon.Get (), EntryBefore ());
+    }
+
+    std::vector<DistanceTable::Entry>::iterator
+    DistanceTable::LowerBound (Ipv4Address beacon)
+    {
+      return std::lower_bound (m_table.begin (), m_table.end (), beacon.Get (), EntryBefore ());
+    }
+
+    BeaconInfo const *
+    DistanceTable::Find (Ipv4Address beacon) const
     {
+      std::vector<Entry>::const_iterator it = LowerBound (beacon);
+      if (it != m_table.end () && it->first == beacon)
+        {
+          return &it->second;
+        }
+      return 0;
     }
 
-    std::map<Ipv4Address, BeaconInfo>  DistanceTable::Inner() {
-      return m_table;
+    BeaconInfo *
+    DistanceTable::Find (Ipv4Address beacon)
+    {
+      std::vector<Entry>::iterator it = LowerBound (beacon);
+      if (it != m_table.end () && it->first == beacon)
+        {
+          return &it->second;
+        }
+      return 0;
+    }
+
+    BeaconInfo &
+    DistanceTable::FindOrInsert (Ipv4Address beacon, bool &inserted)
+    {
+      std::vector<Entry>::iterator it = LowerBound (beacon);
+      inserted = (it == m_table.end () || it->first != beacon);
+      if (inserted)
+        {
+          it = m_table.insert (it, std::make_pair (beacon, BeaconInfo ()));
+        }
+      return it->second;
     }
 
     uint16_t
     DistanceTable::GetHopsTo (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      BeaconInfo const *info = Find (beacon);
+      if (info)
         {
-          return ((BeaconInfo)it->second).GetHops ();
+          return info->GetHops ();
         }
 
       else return 0;
@@ -31,45 +98,120 @@ namespace ns3
     Position
     DistanceTable::GetBeaconPosition (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      BeaconInfo const *info = Find (beacon);
+      if (info)
         {
-          return ((BeaconInfo)it->second).GetPosition ();
+          return info->GetPosition ();
         }
 
       else return std::make_pair<double,double>(-1.0,-1.0);
     }
 
 
+    uint8_t
+    DistanceTable::GetPositionVersion (Ipv4Address beacon) const
+    {
+      BeaconInfo const *info = Find (beacon);
+      if (info)
+        {
+          return info->GetPositionVersion ();
+        }
+
+      else return 0;
+    }
+
+    bool
+    DistanceTable::IsPositionPending (Ipv4Address beacon) const
+    {
+      BeaconInfo const *info = Find (beacon);
+      if (info)
+        {
+          return info->IsPositionPending ();
+        }
+
+      else return false;
+    }
+
+    bool
+    DistanceTable::GetNextHop (Ipv4Address beacon, Ipv4Address &nextHop, uint32_t &interface) const
+    {
+      BeaconInfo const *info = Find (beacon);
+      if (info)
+        {
+          nextHop = info->GetNextHop ();
+          interface = info->GetInterface ();
+          return true;
+        }
+
+      else return false;
+    }
+
     void
-    DistanceTable::AddBeacon (Ipv4Address beacon, uint16_t hops, double xPos, double yPos)
+    DistanceTable::AddBeacon (Ipv4Address beacon, uint16_t hops, double xPos, double yPos, uint16_t seqNo, uint8_t posVersion,
+                              Ipv4Address nextHop, uint32_t interface)
     {
-      std::map<Ipv4Address, BeaconInfo>::iterator it = m_table.find (beacon);
-      BeaconInfo info;
-      if( it != m_table.end ())
+      bool inserted;
+      BeaconInfo &info = FindOrInsert (beacon, inserted);
+      Position pos = std::make_pair (xPos, yPos);
+      bool wasDirty = !inserted && info.IsDirty ();
+      if (inserted || info.GetPosition () != pos || info.GetPositionVersion () != posVersion)
         {
-          info.SetPosition (it->second.GetPosition ());
-          info.SetHops (hops);
-          info.SetTime (Simulator::Now ());
-          it->second = info;
+          info.SetPositionPending (true);
+          info.SetDirty (true);
+          m_version++;
         }
-      else
+      if (info.GetHops () != hops)
         {
-          info.SetHops (hops);
-          info.SetPosition (std::make_pair<double,double>(std::move(xPos), std::move(yPos)));
-          info.SetTime (Simulator::Now ());
-          m_table.insert (std::make_pair<Ipv4Address, BeaconInfo>(std::move(beacon), std::move(info)));
+          info.SetDirty (true);
+          m_version++;
         }
+      //A newer sequence number alone is still advertised, but the HELLOs already serialized only need it patched in
+      if (info.GetSeqNo () != seqNo)
+        {
+          info.SetDirty (true);
+        }
+      if (info.IsDirty () && !wasDirty)
+        {
+          m_dirtyVersion++;
+        }
+      info.SetHops (hops);
+      info.SetSeqNo (seqNo);
+      info.SetPosition (pos);
+      info.SetPositionVersion (posVersion);
+      info.SetNextHop (nextHop);
+      info.SetInterface (interface);
+      info.SetTime (Simulator::Now ());
     }
 
+    bool
+    DistanceTable::RefreshSeqNo (Ipv4Address beacon, uint16_t seqNo)
+    {
+      std::vector<Entry>::iterator it = LowerBound (beacon);
+      if (it == m_table.end () || it->first != beacon)
+        {
+          return false;
+        }
+      BeaconInfo &info = it->second;
+      if (info.GetSeqNo () != seqNo)
+        {
+          //Like a refresh through AddBeacon, patched into the serialized HELLOs
+          if (!info.IsDirty ())
+            {
+              m_dirtyVersion++;
+            }
+          info.SetDirty (true);
+          info.SetSeqNo (seqNo);
+        }
+      return true;
+    }
 
     Time
     DistanceTable::LastUpdatedAt (Ipv4Address beacon) const
     {
-      std::map<Ipv4Address, BeaconInfo>::const_iterator it = m_table.find (beacon);
-      if( it != m_table.end ())
+      BeaconInfo const *info = Find (beacon);
+      if (info)
         {
-          return ((BeaconInfo)it->second).GetTime ();
+          return info->GetTime ();
         }
 
       else return Time::Max ();
@@ -79,18 +221,101 @@ namespace ns3
     DistanceTable::GetKnownBeacons() const
     {
       std::vector<Ipv4Address> theBeacons;
-      for(std::map<Ipv4Address, BeaconInfo>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+      theBeacons.reserve (m_table.size ());
+      for(std::vector<Entry>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
         {
           theBeacons.push_back (j->first);
         }
       return theBeacons;
     }
 
+    std::vector<Ipv4Address>
+    DistanceTable::GetChangedBeacons() const
+    {
+      std::vector<Ipv4Address> theBeacons;
+      for(std::vector<Entry>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+        {
+          if (j->second.IsDirty ())
+            {
+              theBeacons.push_back (j->first);
+            }
+        }
+      return theBeacons;
+    }
+
+    bool
+    DistanceTable::IsDirty (Ipv4Address beacon) const
+    {
+      BeaconInfo const *info = Find (beacon);
+      if (info)
+        {
+          return info->IsDirty ();
+        }
+
+      else return false;
+    }
+
+    void
+    DistanceTable::ClearDirty ()
+    {
+      bool dirty = false;
+      bool pending = false;
+      for(std::vector<Entry>::iterator j = m_table.begin (); j != m_table.end (); ++j)
+        {
+          dirty = dirty || j->second.IsDirty ();
+          pending = pending || j->second.IsPositionPending ();
+          j->second.SetDirty (false);
+          j->second.SetPositionPending (false);
+        }
+      if (pending)
+        {
+          m_version++;
+        }
+      if (dirty)
+        {
+          m_dirtyVersion++;
+        }
+    }
+
+    uint32_t
+    DistanceTable::Purge (Time cutoff, std::vector<Entry> *expired)
+    {
+      size_t before = m_table.size ();
+      if (expired)
+        {
+          for (std::vector<Entry>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+            {
+              if (ExpiredBefore (cutoff) (*j))
+                {
+                  expired->push_back (*j);
+                }
+            }
+        }
+      m_table.erase (std::remove_if (m_table.begin (), m_table.end (), ExpiredBefore (cutoff)), m_table.end ());
+      if (m_table.size () != before)
+        {
+          m_version++;
+          m_dirtyVersion++;
+        }
+      return before - m_table.size ();
+    }
+
+    Time
+    DistanceTable::GetOldestUpdate () const
+    {
+      Time oldest = Time::Max ();
+      for(std::vector<Entry>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+        {
+          oldest = std::min (oldest, j->second.GetTime ());
+        }
+      return oldest;
+    }
+
     void
     DistanceTable::Print (Ptr<OutputStreamWrapper> os) const
     {
       *os->GetStream () << m_table.size () << " entries\n";
-      for(std::map<Ipv4Address,BeaconInfo>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
+      for(std::vector<Entry>::const_iterator j = m_table.begin (); j != m_table.end (); ++j)
         {
           //                    BeaconAddr           BeaconInfo
           *os->GetStream () <<  j->first << "\t" << j->second;
@@ -102,7 +327,7 @@ namespace ns3
     operator<< (std::ostream &os, BeaconInfo const &h)
     {
       std::pair<float,float> pos = h.GetPosition ();
-      os << h.GetHops () << "\t(" << pos.first << ","<< pos.second << ")\t"<< h.GetTime ()<<"\n";
+      os << h.GetHops () << "\t" << h.GetSeqNo () << "\t(" << pos.first << ","<< pos.second << ")\t"<< h.GetTime ()<<"\n";
       return os;
     }
 
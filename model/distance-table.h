@@ -18,18 +18,42 @@ namespace ns3
     class BeaconInfo
     {
     public:
+      BeaconInfo() : m_hops (0), m_seqNo (0), m_posVersion (0), m_dirty (false), m_positionPending (false), m_interface (0) {}
+
       uint16_t  GetHops()     const   { return m_hops;     }
+      //Latest sequence number originated by the beacon that we know of
+      uint16_t  GetSeqNo()    const   { return m_seqNo;    }
       Position  GetPosition() const   { return m_pos;      }
+      uint8_t   GetPositionVersion() const { return m_posVersion; }
       Time      GetTime()     const   { return m_updatedAt;}
+      //True when the hops, sequence number or position changed since the last advertisement
+      bool      IsDirty()     const   { return m_dirty;    }
+      //True when the position changed since the last advertisement
+      bool      IsPositionPending() const  { return m_positionPending; }
+      //Neighbor the entry was learned from, one hop closer to the beacon, and the interface it was heard on
+      Ipv4Address GetNextHop()  const { return m_nextHop;  }
+      uint32_t  GetInterface() const  { return m_interface;}
 
       void SetHops    (uint16_t hops) { m_hops = hops;  }
+      void SetSeqNo   (uint16_t sn)   { m_seqNo = sn;   }
       void SetPosition(Position p)    { m_pos  = p;     }
+      void SetPositionVersion(uint8_t v)   { m_posVersion = v; }
       void SetTime    ( Time t )      { m_updatedAt = t;}
+      void SetDirty   (bool dirty)    { m_dirty = dirty;}
+      void SetPositionPending(bool p) { m_positionPending = p; }
+      void SetNextHop (Ipv4Address n) { m_nextHop = n;  }
+      void SetInterface (uint32_t i)  { m_interface = i;}
 
     private:
       uint16_t m_hops;
+      uint16_t m_seqNo;
       Position m_pos;
+      uint8_t  m_posVersion;
       Time     m_updatedAt;
+      bool     m_dirty;
+      bool     m_positionPending;
+      Ipv4Address m_nextHop;
+      uint32_t m_interface;
     };
 
     std::ostream & operator<< (std::ostream & os, BeaconInfo const &);
@@ -40,13 +64,105 @@ namespace ns3
     /**
      * @brief The DistanceTable class stores local
      *information about the beacons known to the node.
+     *
+     * Entries are kept in a contiguous vector sorted by the raw 32 bits of
+     * the beacon address, so lookups are a binary search and iteration
+     * follows the address order.
      */
     class DistanceTable
     {
     public:
+      typedef std::pair<Ipv4Address, BeaconInfo> Entry;
+      typedef std::vector<Entry>::const_iterator Iterator;
+
+      /**
+       * @brief The BeaconRange class iterates over the addresses of the known beacons without copying them
+       */
+      class BeaconRange
+      {
+      public:
+        class Iterator
+        {
+        public:
+          explicit Iterator(DistanceTable::Iterator it) : m_it (it) {}
+          Ipv4Address const & operator* () const          { return m_it->first; }
+          Ipv4Address const * operator-> () const         { return &m_it->first; }
+          Iterator & operator++ ()                        { ++m_it; return *this; }
+          bool operator== (Iterator const &o) const       { return m_it == o.m_it; }
+          bool operator!= (Iterator const &o) const       { return m_it != o.m_it; }
+        private:
+          DistanceTable::Iterator m_it;
+        };
+
+        BeaconRange(DistanceTable::Iterator b, DistanceTable::Iterator e) : m_begin (b), m_end (e) {}
+        Iterator begin() const { return Iterator (m_begin); }
+        Iterator end()   const { return Iterator (m_end); }
+      private:
+        DistanceTable::Iterator m_begin;
+        DistanceTable::Iterator m_end;
+      };
+
       DistanceTable();
 
-      std::map<Ipv4Address, BeaconInfo>  Inner();
+      /**
+       * @brief Inner Read only access to the entries, sorted by beacon address
+       * @return The entries of this table
+       */
+      std::vector<Entry> const &  Inner() const { return m_table; }
+
+      //Iteration over the entries, sorted by beacon address
+      //{
+      Iterator  Begin() const  { return m_table.begin (); }
+      Iterator  End()   const  { return m_table.end (); }
+      //For range-based for loops
+      Iterator  begin() const  { return m_table.begin (); }
+      Iterator  end()   const  { return m_table.end (); }
+      //}
+
+      /**
+       * @brief ForEach Calls a visitor on every entry, sorted by beacon address
+       * @param visitor Callable as visitor (Ipv4Address const &beacon, BeaconInfo const &info)
+       */
+      template <typename Visitor>
+      void ForEach(Visitor visitor) const
+      {
+        for (Iterator it = m_table.begin (); it != m_table.end (); ++it)
+          {
+            visitor (it->first, it->second);
+          }
+      }
+
+      /**
+       * @brief GetBeacons The addresses of the known beacons, without allocating
+       * @return A range over the beacon addresses
+       */
+      BeaconRange GetBeacons() const { return BeaconRange (m_table.begin (), m_table.end ()); }
+
+      /**
+       * @brief Find Looks up the entry of a beacon
+       * @param beacon The beacon address
+       * @return The entry, or 0 if the beacon is unknown
+       */
+      BeaconInfo const * Find(Ipv4Address beacon) const;
+      BeaconInfo *       Find(Ipv4Address beacon);
+
+      /**
+       * @brief FindOrInsert Looks up the entry of a beacon, creating an empty one if it is unknown
+       * @param beacon The beacon address
+       * @param inserted Set to true if the entry was created
+       * @return The entry
+       */
+      BeaconInfo &       FindOrInsert(Ipv4Address beacon, bool &inserted);
+
+      /**
+       * @brief GetVersion Changes whenever AddBeacon, ClearDirty or Purge change the entries, hops, positions
+       *or pending positions of the table. A refresh that only brings a newer sequence number does not change it.
+       *Changes made through the entries returned by Find or FindOrInsert are not tracked.
+       * @return The version
+       */
+      uint32_t  GetVersion() const { return m_version; }
+      //Changes whenever the set of dirty entries changes
+      uint32_t  GetDirtyVersion() const { return m_dirtyVersion; }
 
       /**
        * @brief GetSize The number of entries stored in this table
@@ -62,6 +178,15 @@ namespace ns3
        */
       uint16_t    GetHopsTo(Ipv4Address beacon) const;
 
+      /**
+       * @brief GetNextHop Gets the neighbor to forward to in order to reach a certain beacon
+       * @param beacon The beacon address
+       * @param nextHop Set to the neighbor address
+       * @param interface Set to the interface the neighbor is reached through
+       * @return False if the beacon is unknown
+       */
+      bool        GetNextHop(Ipv4Address beacon, Ipv4Address &nextHop, uint32_t &interface) const;
+
       /**
        * @brief GetBeaconPosition Get the ordered pair representing the absolute position of the beacon
        * @param beacon The beacon address
@@ -69,6 +194,20 @@ namespace ns3
        */
       Position    GetBeaconPosition(Ipv4Address beacon) const;
 
+      /**
+       * @brief GetPositionVersion Get the version of the beacon position stored in this table
+       * @param beacon The beacon address
+       * @return The version, or 0 if the beacon is unknown
+       */
+      uint8_t     GetPositionVersion(Ipv4Address beacon) const;
+
+      /**
+       * @brief IsPositionPending Whether the position of a beacon must be sent on the next HELLO
+       * @param beacon The beacon address
+       * @return True if the beacon is new or its position changed since it was advertised
+       */
+      bool        IsPositionPending(Ipv4Address beacon) const;
+
       /**
        * @brief LastUpdatedAt Gets the time in which the information for the beacon was updated for the last time
        * @param beacon The address of the beacon
@@ -78,10 +217,51 @@ namespace ns3
 
       /**
        * @brief GetKnownBeacons
-       * @return A vector containing the known beacons
+       * @return A vector containing the known beacons, GetBeacons avoids the copy
        */
       std::vector<Ipv4Address> GetKnownBeacons() const;
 
+      /**
+       * @brief GetChangedBeacons
+       * @return A vector containing the beacons whose entry changed since the last call to ClearDirty
+       */
+      std::vector<Ipv4Address> GetChangedBeacons() const;
+
+      /**
+       * @brief IsDirty Whether the entry of a beacon changed since it was advertised
+       * @param beacon The beacon address
+       * @return True if the hops or the position of the beacon changed
+       */
+      bool IsDirty(Ipv4Address beacon) const;
+
+      /**
+       * @brief ClearDirty Marks every entry as advertised
+       */
+      void ClearDirty();
+
+      /**
+       * @brief Purge Removes the entries not refreshed since a given time
+       * @param cutoff Entries updated at this time or before are removed
+       * @param expired If not null, the removed entries are appended to it
+       * @return The number of removed entries
+       */
+      uint32_t Purge(Time cutoff, std::vector<Entry> *expired = 0);
+
+      /**
+       * @brief RefreshSeqNo Takes a newer sequence number for a beacon without touching its hops, next hop,
+       *position or update time, so the entry is advertised with it but not taken as confirmed
+       * @param beacon The beacon address
+       * @param seqNo The sequence number
+       * @return False if the beacon is unknown
+       */
+      bool RefreshSeqNo(Ipv4Address beacon, uint16_t seqNo);
+
+      /**
+       * @brief GetOldestUpdate The time of the least recently updated entry
+       * @return The time, or Time::Max () if the table is empty
+       */
+      Time GetOldestUpdate() const;
+
       /**
        * @brief Print Print this DistanceTable to the output stream provided
        * @param os The stream
@@ -94,10 +274,20 @@ namespace ns3
        * @param hops Hops to the beacon
        * @param xPos X coordinate
        * @param yPos Y coordinate
+       * @param seqNo Sequence number originated by the beacon
+       * @param posVersion Version of the beacon position
+       * @param nextHop Neighbor the entry was learned from, it is not advertised
+       * @param interface Interface the neighbor was heard on
        */
-      void AddBeacon(Ipv4Address beacon, uint16_t hops, double xPos, double yPos);
+      void AddBeacon(Ipv4Address beacon, uint16_t hops, double xPos, double yPos, uint16_t seqNo = 0, uint8_t posVersion = 0,
+                     Ipv4Address nextHop = Ipv4Address (), uint32_t interface = 0);
     private:
-      std::map<Ipv4Address, BeaconInfo>  m_table;
+      std::vector<Entry>::const_iterator LowerBound(Ipv4Address beacon) const;
+      std::vector<Entry>::iterator       LowerBound(Ipv4Address beacon);
+
+      std::vector<Entry>  m_table;
+      uint32_t            m_version;
+      uint32_t            m_dirtyVersion;
     };
 
 
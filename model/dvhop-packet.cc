@@ -1,15 +1,83 @@
 #include "dvhop-packet.h"
 #include "ns3/packet.h"
 #include "ns3/address-utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 namespace ns3
 {
   namespace dvhop
   {
 
+    namespace
+    {
+      //Bit-exact conversions between floating point numbers and integers
+      uint64_t DoubleToBits (double d)   { uint64_t u; std::memcpy (&u, &d, sizeof (u)); return u; }
+      double   BitsToDouble (uint64_t u) { double d; std::memcpy (&d, &u, sizeof (d)); return d; }
+      uint32_t FloatToBits (float f)     { uint32_t u; std::memcpy (&u, &f, sizeof (u)); return u; }
+      float    BitsToFloat (uint32_t u)  { float f; std::memcpy (&f, &u, sizeof (f)); return f; }
+
+      //Variable length integers, 7 bits per byte, least significant group first
+      uint32_t VarintSize (uint32_t v)
+      {
+        uint32_t size = 1;
+        while (v >= 0x80)
+          {
+            v >>= 7;
+            size++;
+          }
+        return size;
+      }
+
+      void WriteVarint (Buffer::Iterator &i, uint32_t v)
+      {
+        while (v >= 0x80)
+          {
+            i.WriteU8 ((v & 0x7f) | 0x80);
+            v >>= 7;
+          }
+        i.WriteU8 (v);
+      }
+
+      uint32_t ReadVarint (Buffer::Iterator &i)
+      {
+        uint32_t v = 0;
+        for (uint32_t shift = 0; shift < 32; shift += 7)
+          {
+            uint8_t byte = i.ReadU8 ();
+            v |= uint32_t (byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+              {
+                break;
+              }
+          }
+        return v;
+      }
+
+      //Maps signed deltas to unsigned numbers so that small magnitudes get small varints
+      uint32_t ZigZag (int32_t v)    { return (uint32_t (v) << 1) ^ uint32_t (v >> 31); }
+      int32_t  UnZigZag (uint32_t v) { return int32_t (v >> 1) ^ -int32_t (v & 1); }
+
+      int32_t Quantize (double pos, float resolution)
+      {
+        double q = std::floor (pos / resolution + 0.5);
+        q = std::max (q, double (std::numeric_limits<int32_t>::min ()));
+        q = std::min (q, double (std::numeric_limits<int32_t>::max ()));
+        return int32_t (q);
+      }
+    }
+
     NS_OBJECT_ENSURE_REGISTERED (FloodingHeader);
 
-    FloodingHeader::FloodingHeader()
+    FloodingHeader::FloodingHeader() :
+      m_xPos (0),
+      m_yPos (0),
+      m_seqNo (0),
+      m_hopCount (0),
+      m_posVersion (0),
+      m_hasPosition (true)
     {
     }
 
@@ -20,6 +88,8 @@ namespace ns3
       m_seqNo    = seqNo;
       m_hopCount = hopCount;
       m_beaconId = beacon;
+      m_posVersion  = 0;
+      m_hasPosition = true;
     }
 
     TypeId
@@ -47,17 +117,9 @@ namespace ns3
     FloodingHeader::Serialize (Buffer::Iterator start) const
     {
       //The position info are serialized as uint64_t, though they're doubles
-      //We convert the double to a unsigned long and then serialize that number
-      double x = m_xPos;
-      uint64_t dst;
-      char *const p = reinterpret_cast<char*>(&x);
-      std::copy(p, p+sizeof(uint64_t), reinterpret_cast<char*>(&dst));
-      start.WriteHtonU64 (dst);
-
-      double y = m_yPos;
-      char* const p2 = reinterpret_cast<char*>(&y);
-      std::copy(p2, p2+sizeof(uint64_t), reinterpret_cast<char*>(&dst));
-      start.WriteHtonU64 (dst);
+      //We reinterpret the bits of the double as a unsigned long and serialize that number
+      start.WriteHtonU64 (DoubleToBits (m_xPos));
+      start.WriteHtonU64 (DoubleToBits (m_yPos));
 
       start.WriteU16 (m_seqNo);
       start.WriteU16 (m_hopCount);
@@ -70,13 +132,8 @@ namespace ns3
       Buffer::Iterator i = start;
 
 
-      uint64_t midX = i.ReadNtohU64 ();
-      char *const p = reinterpret_cast<char*>(&midX);
-      std::copy(p, p + sizeof(double), reinterpret_cast<char*>(&m_xPos));
-
-      uint64_t midY = i.ReadNtohU64 ();
-      char* const p2 = reinterpret_cast<char*>(&midY);
-      std::copy(p2, p2 + sizeof(double), reinterpret_cast<char*>(&m_yPos));
+      m_xPos = BitsToDouble (i.ReadNtohU64 ());
+      m_yPos = BitsToDouble (i.ReadNtohU64 ());
 
       m_seqNo = i.ReadU16 ();
       m_hopCount = i.ReadU16 ();
@@ -104,5 +161,413 @@ namespace ns3
 
 
 
+    NS_OBJECT_ENSURE_REGISTERED (HelloHeader);
+
+    //Entry count, flags and reserved field
+    const uint32_t HelloHeader::HEADER_SIZE = 4;
+    const uint8_t  HelloHeader::FLAG_COMPACT = 0x01;
+    const uint8_t  HelloHeader::FLAG_INTERNED = 0x02;
+    const uint8_t  HelloHeader::FLAG_POSITION_REQUEST = 0x04;
+    const uint8_t  HelloHeader::FLAG_HOP_SIZE = 0x08;
+    const uint8_t  HelloHeader::FLAG_SENDER_POSITION = 0x10;
+
+    HelloHeader::HelloHeader() :
+      m_compact (false),
+      m_resolution (0.01f),
+      m_interned (false),
+      m_positionRequest (false),
+      m_hasHopSize (false),
+      m_hopSize (0),
+      m_hopSizeHops (0),
+      m_hopSizeSeqNo (0),
+      m_hasSenderPosition (false),
+      m_senderX (0),
+      m_senderY (0)
+    {
+    }
+
+    TypeId
+    HelloHeader::GetTypeId ()
+    {
+      static TypeId tid = TypeId("ns3::dvhop::HelloHeader")
+          .SetParent<Header> ()
+          .AddConstructor<HelloHeader>();
+      return tid;
+    }
+
+    TypeId
+    HelloHeader::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    void
+    HelloHeader::SetCompact (bool compact, double resolution)
+    {
+      NS_ASSERT (resolution > 0);
+      m_compact = compact;
+      m_resolution = resolution;
+    }
+
+    void
+    HelloHeader::SetHopSize (Ipv4Address beacon, double hopSize, uint16_t hops, uint16_t seqNo)
+    {
+      m_hasHopSize = true;
+      m_hopSizeBeacon = beacon;
+      m_hopSize = hopSize;
+      m_hopSizeHops = hops;
+      m_hopSizeSeqNo = seqNo;
+    }
+
+    void
+    HelloHeader::SetSenderPosition (double x, double y)
+    {
+      m_hasSenderPosition = true;
+      m_senderX = x;
+      m_senderY = y;
+    }
+
+    uint32_t
+    HelloHeader::GetHeaderSize () const
+    {
+      uint32_t size = HEADER_SIZE;
+      if (m_compact)
+        {
+          size += 4;
+        }
+      if (m_hasHopSize)
+        {
+          size += 12;
+        }
+      if (m_hasSenderPosition)
+        {
+          size += 8;
+        }
+      return size;
+    }
+
+    uint32_t
+    HelloHeader::GetEntrySize (FloodingHeader const &entry, uint16_t prevSeqNo) const
+    {
+      if (!m_compact && !m_interned)
+        {
+          return entry.GetSerializedSize ();
+        }
+
+      uint32_t size = 4; //Beacon address
+      if (m_compact)
+        {
+          int32_t seqDelta = int32_t (entry.GetSequenceNumber ()) - int32_t (prevSeqNo);
+          size += VarintSize (entry.GetHopCount ()) + VarintSize (ZigZag (seqDelta));
+        }
+      else
+        {
+          size += 4;
+        }
+      if (m_interned)
+        {
+          size += 1;
+        }
+      if (!m_interned || entry.HasPosition ())
+        {
+          size += m_compact ? 8 : 16;
+        }
+      return size;
+    }
+
+    uint16_t
+    HelloHeader::GetMaxEntries (uint32_t payloadSize) const
+    {
+      //Entries are sized for the worst case: with position and 3 bytes varints for hops and sequence delta
+      uint32_t entrySize = m_compact ? 4 + 3 + 3 + 8 : FloodingHeader ().GetSerializedSize ();
+      if (m_interned)
+        {
+          entrySize += 1;
+        }
+      if (payloadSize < GetHeaderSize () + entrySize)
+        {
+          return 1;
+        }
+      uint32_t maxEntries = (payloadSize - GetHeaderSize ()) / entrySize;
+      return std::min<uint32_t> (maxEntries, 0xffff);
+    }
+
+    bool
+    HelloHeader::GetSequenceNumberOffsets (std::vector<uint32_t> &offsets, bool &networkOrder) const
+    {
+      offsets.clear ();
+      if (m_compact)
+        {
+          return false;
+        }
+      //FloodingHeader writes it in host order after the position, the interned entries after the address and hops
+      networkOrder = m_interned;
+      uint32_t offset = GetHeaderSize ();
+      for (std::vector<FloodingHeader>::const_iterator it = m_entries.begin (); it != m_entries.end (); ++it)
+        {
+          offsets.push_back (offset + (m_interned ? 6 : 16));
+          offset += GetEntrySize (*it, 0);
+        }
+      return true;
+    }
+
+    void
+    HelloHeader::WriteSequenceNumber (uint8_t *data, uint32_t offset, uint16_t seqNo, bool networkOrder)
+    {
+      uint8_t high = seqNo >> 8;
+      uint8_t low = seqNo & 0xff;
+      data[offset] = networkOrder ? high : low;
+      data[offset + 1] = networkOrder ? low : high;
+    }
+
+    uint32_t
+    HelloHeader::GetSerializedSize () const
+    {
+      uint32_t size = GetHeaderSize ();
+      uint16_t prevSeqNo = 0;
+      for (std::vector<FloodingHeader>::const_iterator it = m_entries.begin (); it != m_entries.end (); ++it)
+        {
+          size += GetEntrySize (*it, prevSeqNo);
+          prevSeqNo = it->GetSequenceNumber ();
+        }
+      return size;
+    }
+
+    void
+    HelloHeader::Serialize (Buffer::Iterator start) const
+    {
+      Buffer::Iterator i = start;
+      uint8_t flags = 0;
+      if (m_compact)         flags |= FLAG_COMPACT;
+      if (m_interned)        flags |= FLAG_INTERNED;
+      if (m_positionRequest) flags |= FLAG_POSITION_REQUEST;
+      if (m_hasHopSize)      flags |= FLAG_HOP_SIZE;
+      if (m_hasSenderPosition) flags |= FLAG_SENDER_POSITION;
+
+      i.WriteHtonU16 (m_entries.size ());
+      i.WriteU8 (flags);
+      i.WriteU8 (0); //Reserved
+      if (m_compact)
+        {
+          i.WriteHtonU32 (FloatToBits (m_resolution));
+        }
+      if (m_hasHopSize)
+        {
+          WriteTo (i, m_hopSizeBeacon);
+          i.WriteHtonU32 (FloatToBits (m_hopSize));
+          i.WriteHtonU16 (m_hopSizeHops);
+          i.WriteHtonU16 (m_hopSizeSeqNo);
+        }
+      if (m_hasSenderPosition)
+        {
+          i.WriteHtonU32 (FloatToBits (m_senderX));
+          i.WriteHtonU32 (FloatToBits (m_senderY));
+        }
+
+      if (!m_compact && !m_interned)
+        {
+          for (std::vector<FloodingHeader>::const_iterator it = m_entries.begin (); it != m_entries.end (); ++it)
+            {
+              it->Serialize (i);
+              i.Next (it->GetSerializedSize ());
+            }
+          return;
+        }
+
+      uint16_t prevSeqNo = 0;
+      for (std::vector<FloodingHeader>::const_iterator it = m_entries.begin (); it != m_entries.end (); ++it)
+        {
+          WriteTo (i, it->GetBeaconAddress ());
+          if (m_compact)
+            {
+              WriteVarint (i, it->GetHopCount ());
+              WriteVarint (i, ZigZag (int32_t (it->GetSequenceNumber ()) - int32_t (prevSeqNo)));
+            }
+          else
+            {
+              i.WriteHtonU16 (it->GetHopCount ());
+              i.WriteHtonU16 (it->GetSequenceNumber ());
+            }
+          if (m_interned)
+            {
+              i.WriteU8 ((it->HasPosition () ? 0x80 : 0) | it->GetPositionVersion ());
+            }
+          if (!m_interned || it->HasPosition ())
+            {
+              if (m_compact)
+                {
+                  i.WriteHtonU32 (Quantize (it->GetXPosition (), m_resolution));
+                  i.WriteHtonU32 (Quantize (it->GetYPosition (), m_resolution));
+                }
+              else
+                {
+                  i.WriteHtonU64 (DoubleToBits (it->GetXPosition ()));
+                  i.WriteHtonU64 (DoubleToBits (it->GetYPosition ()));
+                }
+            }
+          prevSeqNo = it->GetSequenceNumber ();
+        }
+    }
+
+    uint32_t
+    HelloHeader::Deserialize (Buffer::Iterator start)
+    {
+      Buffer::Iterator i = start;
+
+      uint16_t count = i.ReadNtohU16 ();
+      uint8_t flags = i.ReadU8 ();
+      i.ReadU8 (); //Reserved
+      m_compact = flags & FLAG_COMPACT;
+      m_interned = flags & FLAG_INTERNED;
+      m_positionRequest = flags & FLAG_POSITION_REQUEST;
+      m_hasHopSize = flags & FLAG_HOP_SIZE;
+      m_hasSenderPosition = flags & FLAG_SENDER_POSITION;
+      if (m_compact)
+        {
+          m_resolution = BitsToFloat (i.ReadNtohU32 ());
+        }
+      if (m_hasHopSize)
+        {
+          ReadFrom (i, m_hopSizeBeacon);
+          m_hopSize = BitsToFloat (i.ReadNtohU32 ());
+          m_hopSizeHops = i.ReadNtohU16 ();
+          m_hopSizeSeqNo = i.ReadNtohU16 ();
+        }
+      if (m_hasSenderPosition)
+        {
+          m_senderX = BitsToFloat (i.ReadNtohU32 ());
+          m_senderY = BitsToFloat (i.ReadNtohU32 ());
+        }
+
+      m_entries.clear ();
+      m_entries.reserve (count);
+      if (!m_compact && !m_interned)
+        {
+          for (uint16_t n = 0; n < count; ++n)
+            {
+              FloodingHeader entry;
+              i.Next (entry.Deserialize (i));
+              m_entries.push_back (entry);
+            }
+        }
+      else
+        {
+          uint16_t prevSeqNo = 0;
+          for (uint16_t n = 0; n < count; ++n)
+            {
+              FloodingHeader entry;
+              Ipv4Address beacon;
+              ReadFrom (i, beacon);
+              entry.SetBeaconAddress (beacon);
+              if (m_compact)
+                {
+                  entry.SetHopCount (ReadVarint (i));
+                  entry.SetSequenceNumber (int32_t (prevSeqNo) + UnZigZag (ReadVarint (i)));
+                }
+              else
+                {
+                  entry.SetHopCount (i.ReadNtohU16 ());
+                  entry.SetSequenceNumber (i.ReadNtohU16 ());
+                }
+              if (m_interned)
+                {
+                  uint8_t version = i.ReadU8 ();
+                  entry.SetHasPosition (version & 0x80);
+                  entry.SetPositionVersion (version);
+                }
+              if (entry.HasPosition ())
+                {
+                  if (m_compact)
+                    {
+                      entry.SetXPosition (int32_t (i.ReadNtohU32 ()) * double (m_resolution));
+                      entry.SetYPosition (int32_t (i.ReadNtohU32 ()) * double (m_resolution));
+                    }
+                  else
+                    {
+                      entry.SetXPosition (BitsToDouble (i.ReadNtohU64 ()));
+                      entry.SetYPosition (BitsToDouble (i.ReadNtohU64 ()));
+                    }
+                }
+              m_entries.push_back (entry);
+              prevSeqNo = entry.GetSequenceNumber ();
+            }
+        }
+
+      //Validate the readed bytes match the serialized size
+      uint32_t dist = i.GetDistanceFrom (start);
+      NS_ASSERT (dist == GetSerializedSize () );
+      return dist;
+    }
+
+    void
+    HelloHeader::Print (std::ostream &os) const
+    {
+      os << (m_compact ? "Compact HELLO with " : "HELLO with ") << m_entries.size () << " entries"
+         << (m_interned ? ", interned positions" : "")
+         << (m_positionRequest ? ", requesting positions" : "");
+      if (m_hasHopSize)
+        {
+          os << ", hop size " << m_hopSize << " from " << m_hopSizeBeacon << " (" << m_hopSizeHops << " hops)";
+        }
+      if (m_hasSenderPosition)
+        {
+          os << ", sender at (" << m_senderX << "," << m_senderY << ")";
+        }
+      os << "\n";
+      for (std::vector<FloodingHeader>::const_iterator it = m_entries.begin (); it != m_entries.end (); ++it)
+        {
+          it->Print (os);
+        }
+    }
+
+    std::ostream &
+    operator<< (std::ostream &os, HelloHeader const &h)
+    {
+      h.Print (os);
+      return os;
+    }
+
+
+    NS_OBJECT_ENSURE_REGISTERED (GradientTag);
+
+    TypeId
+    GradientTag::GetTypeId ()
+    {
+      static TypeId tid = TypeId ("ns3::dvhop::GradientTag")
+          .SetParent<Tag> ()
+          .AddConstructor<GradientTag> ();
+      return tid;
+    }
+
+    TypeId
+    GradientTag::GetInstanceTypeId () const
+    {
+      return GetTypeId ();
+    }
+
+    uint32_t
+    GradientTag::GetSerializedSize () const
+    {
+      return 0;
+    }
+
+    void
+    GradientTag::Serialize (TagBuffer /*i*/) const
+    {
+    }
+
+    void
+    GradientTag::Deserialize (TagBuffer /*i*/)
+    {
+    }
+
+    void
+    GradientTag::Print (std::ostream &os) const
+    {
+      os << "gradient";
+    }
+
+
+
   }
 }
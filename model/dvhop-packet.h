@@ -2,7 +2,10 @@
 #define DVHOP_PACKET_H
 
 #include <iostream>
+#include <vector>
+#include <stdint.h>
 #include "ns3/header.h"
+#include "ns3/tag.h"
 #include "ns3/enum.h"
 #include "ns3/ipv4-address.h"
 
@@ -52,12 +55,17 @@ namespace ns3
       void SetYPosition(double pos)         { m_yPos = pos;   }
       void SetSequenceNumber(uint16_t sn)  { m_seqNo = sn;   }
       void SetBeaconAddress(Ipv4Address a) { m_beaconId = a; }
+      //Only sent inside a HelloHeader with interned positions
+      void SetPositionVersion(uint8_t v)   { m_posVersion = v & 0x7f; }
+      void SetHasPosition(bool has)        { m_hasPosition = has; }
 
-      double    GetXPosition()        {   return m_xPos;     }
-      double    GetYPosition()        {   return m_yPos;     }
-      uint16_t GetHopCount()         {   return m_hopCount; }
-      uint16_t GetSequenceNumber()   {   return m_seqNo;    }
-      Ipv4Address GetBeaconAddress() {   return m_beaconId; }
+      double    GetXPosition()       const {   return m_xPos;     }
+      double    GetYPosition()       const {   return m_yPos;     }
+      uint16_t GetHopCount()         const {   return m_hopCount; }
+      uint16_t GetSequenceNumber()   const {   return m_seqNo;    }
+      Ipv4Address GetBeaconAddress() const {   return m_beaconId; }
+      uint8_t  GetPositionVersion()  const {   return m_posVersion; }
+      bool     HasPosition()         const {   return m_hasPosition; }
 
 
     private:
@@ -66,11 +74,206 @@ namespace ns3
       uint16_t     m_seqNo;
       uint16_t     m_hopCount;
       Ipv4Address  m_beaconId;
+      uint8_t      m_posVersion;
+      bool         m_hasPosition;
     };
 
     std::ostream & operator<< (std::ostream & os, FloodingHeader const &);
 
 
+
+    /*
+    0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |         Entry count           |     Flags     |   Reserved    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |             Position resolution (float, only if compact)      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |            Hop size beacon address (only if hop size)         |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                 Hop size (float, only if hop size)            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |   Hops to hop size beacon     |   Hop size sequence number    |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |           Sender X position (float, only if sender position)  |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |           Sender Y position (float, only if sender position)  |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                                                               |
+    ~                      Entry count x Entry                      ~
+    |                                                               |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    Flags: 0x01 compact, 0x02 interned positions, 0x04 position request,
+           0x08 hop size, 0x10 sender position.
+
+    Each entry is a FloodingHeader (24 bytes). When the compact or the
+    interned flags are set the entries are encoded instead as:
+
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |                        Beacon IP address                      |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |  Hops (16 bits, varint if compact)                            |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |  Seq. number (16 bits, zigzag varint delta if compact)        |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |P| Pos version |  (only if interned, P set if a position follows)
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |  X Position (double, signed 32 bits / resolution if compact)  |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    |  Y Position (double, signed 32 bits / resolution if compact)  |
+    +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    */
+    /**
+     * @brief The HelloHeader class packs the information of several beacons
+     *in a single HELLO packet, instead of sending one packet per beacon.
+     */
+    class HelloHeader: public Header
+    {
+    public:
+
+      HelloHeader();
+
+      //Serializing and deserializing
+      //{
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual void     Serialize (Buffer::Iterator start) const;
+      virtual uint32_t Deserialize (Buffer::Iterator start);
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Print (std::ostream &os) const;
+      //}
+
+      /**
+       * @brief AddEntry Appends the information of one beacon to this HELLO
+       * @param entry The beacon information
+       */
+      void AddEntry(FloodingHeader const &entry) { m_entries.push_back (entry); }
+
+      /**
+       * @brief Clear Removes every entry of this HELLO
+       */
+      void Clear()                              { m_entries.clear (); }
+
+      uint16_t GetEntryCount() const            { return m_entries.size (); }
+      std::vector<FloodingHeader> const & GetEntries() const { return m_entries; }
+
+      /**
+       * @brief SetCompact Selects the compact encoding of the entries
+       * @param compact True to quantize positions and use varints for hops and sequence numbers
+       * @param resolution The position step, in meters, of the compact encoding
+       */
+      void SetCompact(bool compact, double resolution = 0.01);
+      bool IsCompact() const                    { return m_compact; }
+      double GetResolution() const              { return m_resolution; }
+
+      /**
+       * @brief SetInterned Lets entries omit the position of beacons already known by the neighbors
+       * @param interned True to send a position version on every entry and the position only when flagged
+       */
+      void SetInterned(bool interned)           { m_interned = interned; }
+      bool IsInterned() const                   { return m_interned; }
+
+      /**
+       * @brief SetPositionRequest Asks the neighbors to include positions on their next HELLO
+       * @param request True if the sender received entries for beacons whose position it doesn't know
+       */
+      void SetPositionRequest(bool request)     { m_positionRequest = request; }
+      bool IsPositionRequest() const            { return m_positionRequest; }
+
+      /**
+       * @brief SetHopSize Attaches the average hop distance computed by a beacon
+       * @param beacon The beacon that computed the hop size
+       * @param hopSize The average distance per hop, in meters
+       * @param hops The hops between the sender and the beacon
+       * @param seqNo Sequence number of the hop size, increased by the beacon on each change
+       */
+      void SetHopSize(Ipv4Address beacon, double hopSize, uint16_t hops, uint16_t seqNo);
+      void ClearHopSize()                       { m_hasHopSize = false; }
+      bool HasHopSize() const                   { return m_hasHopSize; }
+      Ipv4Address GetHopSizeBeacon() const      { return m_hopSizeBeacon; }
+      double GetHopSize() const                 { return m_hopSize; }
+      uint16_t GetHopSizeHops() const           { return m_hopSizeHops; }
+      uint16_t GetHopSizeSeqNo() const          { return m_hopSizeSeqNo; }
+
+      /**
+       * @brief SetSenderPosition Attaches the position of the sender, beacon or estimated, for geographic forwarding
+       * @param x X coordinate
+       * @param y Y coordinate
+       */
+      void SetSenderPosition(double x, double y);
+      void ClearSenderPosition()                { m_hasSenderPosition = false; }
+      bool HasSenderPosition() const            { return m_hasSenderPosition; }
+      double GetSenderX() const                 { return m_senderX; }
+      double GetSenderY() const                 { return m_senderY; }
+
+      /**
+       * @brief GetMaxEntries How many entries fit in a HELLO with this encoding
+       * @param payloadSize The bytes available for the HELLO (MTU minus IP and UDP headers)
+       * @return The number of entries that fit, at least one
+       */
+      uint16_t GetMaxEntries(uint32_t payloadSize) const;
+
+      /**
+       * @brief GetSequenceNumberOffsets Where the sequence number of each entry is in the serialized header,
+       *so a HELLO serialized once can be resent with newer sequence numbers
+       * @param offsets Set to one byte offset per entry
+       * @param networkOrder Set to the byte order of the sequence numbers
+       * @return False with the compact encoding, its sequence numbers are varint deltas that can not be patched
+       */
+      bool GetSequenceNumberOffsets(std::vector<uint32_t> &offsets, bool &networkOrder) const;
+      static void WriteSequenceNumber(uint8_t *data, uint32_t offset, uint16_t seqNo, bool networkOrder);
+
+    private:
+      static const uint32_t HEADER_SIZE;
+      static const uint8_t  FLAG_COMPACT;
+      static const uint8_t  FLAG_INTERNED;
+      static const uint8_t  FLAG_POSITION_REQUEST;
+      static const uint8_t  FLAG_HOP_SIZE;
+      static const uint8_t  FLAG_SENDER_POSITION;
+
+      uint32_t GetHeaderSize () const;
+      uint32_t GetEntrySize (FloodingHeader const &entry, uint16_t prevSeqNo) const;
+
+      std::vector<FloodingHeader> m_entries;
+      bool   m_compact;
+      float  m_resolution;
+      bool   m_interned;
+      bool   m_positionRequest;
+
+      bool        m_hasHopSize;
+      Ipv4Address m_hopSizeBeacon;
+      float       m_hopSize;
+      uint16_t    m_hopSizeHops;
+      uint16_t    m_hopSizeSeqNo;
+
+      bool        m_hasSenderPosition;
+      float       m_senderX;
+      float       m_senderY;
+    };
+
+    std::ostream & operator<< (std::ostream & os, HelloHeader const &);
+
+
+    /**
+     * @brief The GradientTag class marks a unicast packet that reached a dead end of greedy geographic
+     *forwarding. From there on it only follows the hop-count gradient toward its beacon destination,
+     *so no node sends it back into greedy forwarding. It carries no data.
+     */
+    class GradientTag: public Tag
+    {
+    public:
+      static TypeId    GetTypeId (void);
+      TypeId           GetInstanceTypeId () const;
+      virtual uint32_t GetSerializedSize () const;
+      virtual void     Serialize (TagBuffer i) const;
+      virtual void     Deserialize (TagBuffer i);
+      virtual void     Print (std::ostream &os) const;
+    };
+
+
   }
 }
 
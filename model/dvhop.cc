@@ -4,14 +4,19 @@
 #include "dvhop-packet.h"
 #include "ns3/log.h"
 #include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/udp-socket-factory.h"
+#include "ns3/udp-header.h"
 #include "ns3/wifi-net-device.h"
 #include "ns3/adhoc-wifi-mac.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include <cmath>
 
 
 
@@ -22,6 +27,15 @@ namespace ns3 {
 
   namespace dvhop{
 
+    namespace
+    {
+      //Serial number arithmetic (RFC 1982), true if a is more recent than b
+      bool IsNewerSeqNo (uint16_t a, uint16_t b)
+      {
+        return int16_t (a - b) > 0;
+      }
+    }
+
     NS_OBJECT_ENSURE_REGISTERED (RoutingProtocol);
 
 
@@ -35,11 +49,120 @@ namespace ns3 {
                          TimeValue (Seconds (1)),                              // default value
                          MakeTimeAccessor (&RoutingProtocol::HelloInterval),   // accessed through
                          MakeTimeChecker ())
+          .AddAttribute ("HelloMode",
+                         "Which entries of the distance table are advertised on each HELLO.",
+                         EnumValue (FULL_HELLO),
+                         MakeEnumAccessor (&RoutingProtocol::m_helloMode),
+                         MakeEnumChecker (FULL_HELLO, "Full",
+                                          DELTA_HELLO, "Delta",
+                                          HYBRID_HELLO, "Hybrid"))
+          .AddAttribute ("FullRefreshInterval",
+                         "Time between HELLOs carrying the whole table when HelloMode is Hybrid.",
+                         TimeValue (Seconds (10)),
+                         MakeTimeAccessor (&RoutingProtocol::m_fullRefreshInterval),
+                         MakeTimeChecker ())
+          .AddAttribute ("CompactHello",
+                         "Encode HELLO entries with quantized positions and varint hops and sequence numbers.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_compactHello),
+                         MakeBooleanChecker ())
+          .AddAttribute ("PositionResolution",
+                         "Position step, in meters, of the compact HELLO encoding.",
+                         DoubleValue (0.01),
+                         MakeDoubleAccessor (&RoutingProtocol::m_positionResolution),
+                         MakeDoubleChecker<double> (1e-6))
+          .AddAttribute ("InternPositions",
+                         "Send the position of a beacon only when it is new or changed, or a neighbor asks for it.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_internPositions),
+                         MakeBooleanChecker ())
+          .AddAttribute ("EnableTrickle",
+                         "Schedule HELLOs with the Trickle algorithm instead of every HelloInterval.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_enableTrickle),
+                         MakeBooleanChecker ())
+          .AddAttribute ("TrickleImin",
+                         "Minimum Trickle interval, used after an inconsistency is found.",
+                         TimeValue (MilliSeconds (100)),
+                         MakeTimeAccessor (&RoutingProtocol::m_trickleImin),
+                         MakeTimeChecker ())
+          .AddAttribute ("TrickleImax",
+                         "Maximum Trickle interval, reached while the tables are consistent.",
+                         TimeValue (Seconds (60)),
+                         MakeTimeAccessor (&RoutingProtocol::m_trickleImax),
+                         MakeTimeChecker ())
+          .AddAttribute ("TrickleRedundancy",
+                         "Consistent HELLOs heard in an interval that suppress our own HELLO.",
+                         UintegerValue (3),
+                         MakeUintegerAccessor (&RoutingProtocol::m_trickleK),
+                         MakeUintegerChecker<uint32_t> (1))
+          .AddAttribute ("EntryLifetime",
+                         "Time after which a beacon entry without fresh information is removed, 0 to keep entries forever. "
+                         "Beacons then advertise a new sequence number every third of it even in Delta mode, and with "
+                         "Trickle every node sends a HELLO at least that often, its interval never growing above a third "
+                         "of it. It must exceed three times the time a HELLO takes to cross the network.",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&RoutingProtocol::m_entryLifetime),
+                         MakeTimeChecker ())
+          .AddAttribute ("SettlingTime",
+                         "Time a beacon entry keeps its path against longer ones with a newer sequence number from "
+                         "other neighbors while its next hop stays silent, so a lost or late HELLO does not switch "
+                         "the path back and forth. It should stay below EntryLifetime.",
+                         TimeValue (Seconds (3)),
+                         MakeTimeAccessor (&RoutingProtocol::m_settlingTime),
+                         MakeTimeChecker ())
+          .AddAttribute ("HopSizeHoldTime",
+                         "Time without table changes before a beacon computes its hop size.",
+                         TimeValue (Seconds (2)),
+                         MakeTimeAccessor (&RoutingProtocol::m_hopSizeHoldTime),
+                         MakeTimeChecker ())
+          .AddAttribute ("HopSizeScope",
+                         "Maximum hops from the beacon at which its hop size is flooded.",
+                         UintegerValue (10),
+                         MakeUintegerAccessor (&RoutingProtocol::m_hopSizeScope),
+                         MakeUintegerChecker<uint16_t> (1))
+          .AddAttribute ("GeographicForwarding",
+                         "Forward unicast packets greedily toward the registered position of the destination. "
+                         "A packet reaching a dead end, where no neighbor is closer to the destination, follows "
+                         "the hop-count gradient from then on if the destination is a beacon and never returns to "
+                         "greedy forwarding. There is no perimeter mode: any other destination is dropped there.",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&RoutingProtocol::m_geoForwarding),
+                         MakeBooleanChecker ())
+          .AddAttribute ("NeighborLifetime",
+                         "Time after which a neighbor not heard is not used by geographic forwarding.",
+                         TimeValue (Seconds (3)),
+                         MakeTimeAccessor (&RoutingProtocol::m_neighborLifetime),
+                         MakeTimeChecker ())
           .AddAttribute ("UniformRv",
                          "Access to the underlying UniformRandomVariable",
                          StringValue ("ns3::UniformRandomVariable"),
                          MakePointerAccessor (&RoutingProtocol::m_URandom),
-                         MakePointerChecker<UniformRandomVariable> ());                                  // the checker is used to set bounds in values
+                         MakePointerChecker<UniformRandomVariable> ())                                   // the checker is used to set bounds in values
+          .AddTraceSource ("PositionEstimate",
+                           "The position estimated by this node changed.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_estimateTrace),
+                           "ns3::dvhop::RoutingProtocol::PositionTracedCallback")
+          .AddTraceSource ("HelloTx",
+                           "A HELLO was built for transmission, with its entry count and size in bytes.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_helloTxTrace),
+                           "ns3::dvhop::RoutingProtocol::HelloTxTracedCallback")
+          .AddTraceSource ("HelloRx",
+                           "A HELLO was received, with its sender, entry count and size in bytes.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_helloRxTrace),
+                           "ns3::dvhop::RoutingProtocol::HelloRxTracedCallback")
+          .AddTraceSource ("TableUpdate",
+                           "A beacon was inserted in the table (old hops 0), its entry improved or changed, or it expired (new hops 0).",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_tableUpdateTrace),
+                           "ns3::dvhop::RoutingProtocol::TableUpdateTracedCallback")
+          .AddTraceSource ("StaleEntry",
+                           "A received entry was dropped as old or not better than the table.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_staleEntryTrace),
+                           "ns3::dvhop::RoutingProtocol::StaleEntryTracedCallback")
+          .AddTraceSource ("HopSize",
+                           "The hop size was computed by this beacon (hops 0) or taken from a nearer or newer one.",
+                           MakeTraceSourceAccessor (&RoutingProtocol::m_hopSizeTrace),
+                           "ns3::dvhop::RoutingProtocol::HopSizeTracedCallback");
       return tid;
     }
 
@@ -51,12 +174,49 @@ namespace ns3 {
     RoutingProtocol::RoutingProtocol () :
       HelloInterval (Seconds (1)),         //Send HELLO each second
       m_htimer (Timer::CANCEL_ON_DESTROY), //Set timer for HELLO
+      m_helloRoundId (0),
+      m_helloMode (FULL_HELLO),
+      m_fullRefreshInterval (Seconds (10)),
+      m_lastFullHello (Seconds (0)),
+      m_ownInfoChanged (true),
+      m_lastSelfAdvertised (Seconds (0)),
+      m_lastHelloSent (Seconds (0)),
+      m_compactHello (false),
+      m_positionResolution (0.01),
+      m_internPositions (false),
+      m_posVersion (0),
+      m_positionRequested (false),
+      m_requestPositions (false),
+      m_enableTrickle (false),
+      m_trickleImin (MilliSeconds (100)),
+      m_trickleImax (Seconds (60)),
+      m_trickleK (3),
+      m_trickleCounter (0),
+      m_trickleTimer (Timer::CANCEL_ON_DESTROY),
+      m_lastTableChange (Seconds (0)),
+      m_settlingTime (Seconds (3)),
+      m_hopSizeHoldTime (Seconds (2)),
+      m_hopSizeScope (10),
+      m_hasHopSize (false),
+      m_hopSizeDirty (false),
+      m_hopSize (0),
+      m_hopSizeHops (0),
+      m_hopSizeSeqNo (0),
+      m_entryLifetime (Seconds (0)),
+      m_agingTimer (Timer::CANCEL_ON_DESTROY),
+      m_estimateDirty (false),
+      m_hasEstimate (false),
+      m_geoForwarding (false),
+      m_neighborLifetime (Seconds (3)),
+      m_positionPublished (false),
       m_isBeacon(false),
       m_xPosition(12.56),
       m_yPosition(468.5),
       m_seqNo (0),
       m_isDead (0)
     {
+      //The own beacon set only changes with the table, keep its terms and nothing else
+      m_localizer.SetMaxCachedSets (1);
     }
 
 
@@ -82,6 +242,9 @@ namespace ns3 {
           iter->first->Close ();
         }
       m_socketAddresses.clear ();
+      m_interfaces.clear ();
+      m_helloRound = 0;
+      m_locations = 0;
       Ipv4RoutingProtocol::DoDispose ();
     }
 
@@ -112,6 +275,14 @@ namespace ns3 {
           return route;
         }
 
+      //Unicast toward a located node or a known beacon goes through a neighbor
+      Ptr<Ipv4Route> unicastRoute = LookupRoute (header.GetDestination (), p);
+      if (unicastRoute && (!oif || oif == unicastRoute->GetOutputDevice ()))
+        {
+          NS_LOG_DEBUG ("Sending packet to " << header.GetDestination () << " through " << unicastRoute->GetGateway ());
+          sockerr = Socket::ERROR_NOTERROR;
+          return unicastRoute;
+        }
 
       int32_t ifIndex = m_ipv4->GetInterfaceForDevice(oif); //Get the interface for this device
       if(ifIndex < 0 )
@@ -122,10 +293,24 @@ namespace ns3 {
           return route;
         }
 
-      Ipv4InterfaceAddress iface = m_ipv4->GetAddress(ifIndex, 0);
       sockerr = Socket::ERROR_NOTERROR;
       Ipv4Address dst = header.GetDestination ();
 
+      //Every packet leaves through the broadcast of the interface. Callers may keep the route,
+      //so each gets its own, filled from what the DV-Hop interface already knows
+      if (uint32_t (ifIndex) < m_interfaces.size () && m_interfaces[ifIndex].socket)
+        {
+          InterfaceState const &state = m_interfaces[ifIndex];
+          NS_LOG_DEBUG("Sending packet to: " << dst<< ", From:"<< state.iface.GetLocal ());
+          Ptr<Ipv4Route> route = Create<Ipv4Route> ();
+          route->SetDestination (dst);
+          route->SetGateway (state.iface.GetBroadcast ());//nextHop
+          route->SetSource (state.iface.GetLocal ());
+          route->SetOutputDevice (state.device);
+          return route;
+        }
+
+      Ipv4InterfaceAddress iface = m_ipv4->GetAddress(ifIndex, 0);
       NS_LOG_DEBUG("Sending packet to: " << dst<< ", From:"<< iface.GetLocal ());
 
       //Construct a route object to return
@@ -144,7 +329,7 @@ namespace ns3 {
  *Incoming packets on this node arrive here, they're processed to upper layers or the protocol itself
  */
     bool
-    RoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev, UnicastForwardCallback ufcb, MulticastForwardCallback mfcb, LocalDeliverCallback ldcb, ErrorCallback errcb)
+    RoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev, UnicastForwardCallback ufcb, MulticastForwardCallback /*mfcb*/, LocalDeliverCallback ldcb, ErrorCallback errcb)
     {
       if (m_isDead) {
          return false;
@@ -168,41 +353,29 @@ namespace ns3 {
 
       if(dst.IsMulticast ())
         {//Deal with the multicast packet
+          //Not forwarded, DV-Hop has no multicast routes
           NS_LOG_DEBUG ("Multicast destination...");
-
-          //mfcb(p,header,iif);
         }
 
       //Broadcast local delivery or forwarding
-      for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
-        {
-          Ipv4InterfaceAddress iface = j->second;
-          if(m_ipv4->GetInterfaceForAddress (iface.GetLocal ()) == iif)
-            {//We got the interface that received the packet
-              if(dst == iface.GetBroadcast () || dst.IsBroadcast ())
-                {//...and it's a broadcasted packet
-                  Ptr<Packet> packet = p->Copy ();
-                  if(  ! ldcb.IsNull () )
-                    {//Forward the packet to further processing to the LocalDeliveryCallback defined
-                      NS_LOG_DEBUG("Forwarding packet to Local Delivery Callback");
-                      ldcb(packet,header,iif);
-                    }
-                  else
-                    {
-                      NS_LOG_DEBUG("Unable to deliver packet: LocalDeliverCallback is null.");
-                      errcb(packet,header,Socket::ERROR_NOROUTETOHOST);
-                    }
-                  if (header.GetTtl () > 1)
-                    {
-                      NS_LOG_DEBUG ("Forward broadcast...");
-                      //Get a route and call UnicastForwardCallback
-                    }
-                  else
-                    {
-                      NS_LOG_DEBUG ("TTL Exceeded, drop packet");
-                    }
-                  return true;
+      if (uint32_t (iif) < m_interfaces.size () && m_interfaces[iif].socket)
+        {//We got the interface that received the packet
+          Ipv4InterfaceAddress const &iface = m_interfaces[iif].iface;
+          if(dst == iface.GetBroadcast () || dst.IsBroadcast ())
+            {//...and it's a broadcasted packet, the callbacks take a const packet so no copy is needed
+              if(  ! ldcb.IsNull () )
+                {//Forward the packet to further processing to the LocalDeliveryCallback defined
+                  NS_LOG_DEBUG("Forwarding packet to Local Delivery Callback");
+                  ldcb(p,header,iif);
                 }
+              else
+                {
+                  NS_LOG_DEBUG("Unable to deliver packet: LocalDeliverCallback is null.");
+                  errcb(p,header,Socket::ERROR_NOROUTETOHOST);
+                }
+              //Broadcasts stay on the link, HELLOs carry the flooding themselves
+              //and unicast traffic is forwarded by Forwarding
+              return true;
             }
         }
 
@@ -234,7 +407,22 @@ namespace ns3 {
       NS_ASSERT (m_ipv4 == 0);
 
       m_htimer.SetFunction (&RoutingProtocol::HelloTimerExpire, this);
-      m_htimer.Schedule (RoutingProtocol::HelloInterval);
+      if (m_enableTrickle)
+        {
+          m_trickleTimer.SetFunction (&RoutingProtocol::TrickleTimerExpire, this);
+          m_trickleInterval = m_trickleImin;
+          TrickleStartInterval ();
+        }
+      else
+        {
+          m_htimer.Schedule (RoutingProtocol::HelloInterval);
+        }
+
+      if (m_entryLifetime.IsStrictlyPositive ())
+        {
+          m_agingTimer.SetFunction (&RoutingProtocol::AgingTimerExpire, this);
+          m_agingTimer.Schedule (m_entryLifetime);
+        }
 
       m_ipv4 = ipv4;
 
@@ -265,6 +453,7 @@ namespace ns3 {
       socket->SetAllowBroadcast (true);
       socket->SetAttribute ("IpTtl", UintegerValue (1));
       m_socketAddresses.insert (std::make_pair (socket, iface));
+      UpdateInterfaces ();
 
     }
 
@@ -279,10 +468,12 @@ namespace ns3 {
       NS_ASSERT (socket);
       socket->Close ();
       m_socketAddresses.erase (socket);
+      UpdateInterfaces ();
       if (m_socketAddresses.empty ())
         {
           NS_LOG_LOGIC ("No DV-Hop interfaces");
           m_htimer.Cancel ();
+          m_trickleTimer.Cancel ();
           return;
         }
     }
@@ -312,6 +503,7 @@ namespace ns3 {
               socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DVHOP_PORT));
               socket->SetAllowBroadcast (true);
               m_socketAddresses.insert (std::make_pair (socket, iface));
+              UpdateInterfaces ();
             }
         }
       else
@@ -343,10 +535,12 @@ namespace ns3 {
               socket->SetAllowBroadcast (true);
               m_socketAddresses.insert (std::make_pair (socket, iface));
             }
+          UpdateInterfaces ();
           if (m_socketAddresses.empty ())
             {
               NS_LOG_LOGIC ("No aodv interfaces");
               m_htimer.Cancel ();
+              m_trickleTimer.Cancel ();
               return;
             }
         }
@@ -357,10 +551,48 @@ namespace ns3 {
     }
 
 
+    void
+    RoutingProtocol::UpdateInterfaces ()
+    {
+      m_interfaces.clear ();
+      m_interfaces.resize (m_ipv4->GetNInterfaces ());
+      for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+        {
+          int32_t ifIndex = m_ipv4->GetInterfaceForAddress (j->second.GetLocal ());
+          if (ifIndex < 0)
+            {
+              continue;
+            }
+          InterfaceState &state = m_interfaces[ifIndex];
+          state.socket = j->first;
+          state.iface = j->second;
+          state.device = m_ipv4->GetNetDevice (ifIndex);
+        }
+      //New addresses must be published
+      m_positionPublished = false;
+    }
+
     void
     RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
     {
-      *stream->GetStream () << "(" << m_ipv4->GetObject<Node>()->GetId() << " - Not implemented yet";
+      std::ostream *os = stream->GetStream ();
+      *os << "Node: " << m_ipv4->GetObject<Node> ()->GetId ()
+          << ", Time: " << Simulator::Now ().As (unit)
+          << ", DV-Hop routes to " << m_disTable.GetSize () << " beacons\n";
+      *os << "Beacon\tNextHop\tInterface\tHops\tSeqNo\tPosition\tUpdated\n";
+      for (DistanceTable::Iterator it = m_disTable.Begin (); it != m_disTable.End (); ++it)
+        {
+          BeaconInfo const &info = it->second;
+          *os << it->first << "\t" << info.GetNextHop () << "\t" << info.GetInterface () << "\t"
+              << info.GetHops () << "\t" << info.GetSeqNo () << "\t("
+              << info.GetPosition ().first << "," << info.GetPosition ().second << ")\t"
+              << info.GetTime ().As (unit) << "\n";
+        }
+      if (m_geoForwarding)
+        {
+          *os << m_neighbors.GetSize () << " neighbors for geographic forwarding\n";
+        }
+      *os << "\n";
     }
 
 
@@ -402,96 +634,629 @@ namespace ns3 {
     {
       NS_LOG_DEBUG ("HelloTimer expired");
 
+      if (m_enableTrickle)
+        {
+          //The next HELLO is scheduled when the current Trickle interval ends. With aging, a suppressed
+          //node must still refresh the entries of its neighbors before they expire
+          if (m_trickleCounter < m_trickleK || IsRefreshDue (m_lastHelloSent)
+              || (m_isBeacon && IsRefreshDue (m_lastSelfAdvertised)))
+            {
+              SendHello ();
+            }
+          else
+            {
+              NS_LOG_DEBUG ("HELLO suppressed, " << m_trickleCounter << " consistent HELLOs heard");
+            }
+          return;
+        }
+
       SendHello ();
 
       m_htimer.Cancel ();
       m_htimer.Schedule (RoutingProtocol::HelloInterval);
     }
 
+    void
+    RoutingProtocol::TrickleStartInterval ()
+    {
+      //Transmit at a random point of the second half of the interval
+      m_trickleCounter = 0;
+      double half = m_trickleInterval.GetSeconds () / 2;
+      Time t = Seconds (m_URandom->GetValue (half, 2 * half));
+
+      m_htimer.Cancel ();
+      m_htimer.Schedule (t);
+      m_trickleTimer.Cancel ();
+      m_trickleTimer.Schedule (m_trickleInterval);
+    }
+
+    void
+    RoutingProtocol::TrickleTimerExpire ()
+    {
+      //Nothing changed during the whole interval, double it
+      m_trickleInterval = std::min (m_trickleInterval + m_trickleInterval, GetTrickleImax ());
+      NS_LOG_DEBUG ("Trickle interval doubled to " << m_trickleInterval.GetSeconds () << "s");
+      TrickleStartInterval ();
+    }
+
+    Time
+    RoutingProtocol::GetTrickleImax () const
+    {
+      if (!m_entryLifetime.IsStrictlyPositive ())
+        {
+          return m_trickleImax;
+        }
+      return std::max (m_trickleImin, std::min (m_trickleImax, Seconds (m_entryLifetime.GetSeconds () / 3)));
+    }
+
+    bool
+    RoutingProtocol::IsRefreshDue (Time lastSent) const
+    {
+      return m_entryLifetime.IsStrictlyPositive ()
+          && Simulator::Now () - lastSent >= Seconds (m_entryLifetime.GetSeconds () / 3);
+    }
+
+    void
+    RoutingProtocol::TrickleReset ()
+    {
+      if (!m_enableTrickle || m_trickleInterval <= m_trickleImin)
+        {
+          return;
+        }
+      NS_LOG_DEBUG ("Trickle reset to " << m_trickleImin.GetSeconds () << "s");
+      m_trickleInterval = m_trickleImin;
+      TrickleStartInterval ();
+    }
+
+    void
+    RoutingProtocol::AgingTimerExpire ()
+    {
+      Time now = Simulator::Now ();
+      m_expired.clear ();
+      uint32_t purged = m_disTable.Purge (now - m_entryLifetime, &m_expired);
+      if (purged > 0)
+        {
+          NS_LOG_DEBUG ("Purged " << purged << " expired entries");
+          m_lastTableChange = now;
+          m_estimateDirty = true;
+          for (size_t i = 0; i < m_expired.size (); i++)
+            {
+              m_tableUpdateTrace (m_expired[i].first, m_expired[i].second.GetHops (), 0);
+            }
+        }
+
+      //Wake up when the oldest remaining entry expires
+      Time next = m_entryLifetime;
+      if (m_disTable.GetSize () > 0)
+        {
+          next = m_disTable.GetOldestUpdate () + m_entryLifetime - now;
+        }
+      m_agingTimer.Schedule (next);
+    }
+
     bool
     RoutingProtocol::Forwarding(Ptr<const Packet> p, const Ipv4Header &header, Ipv4RoutingProtocol::UnicastForwardCallback ufcb, Ipv4RoutingProtocol::ErrorCallback errcb)
     {
-      //Not forwarding packets for the moment
-     return false;
+      //Each hop moves the packet closer to the destination position, or one hop down the gradient to a beacon
+      Ipv4Address dst = header.GetDestination ();
+      Ptr<Ipv4Route> route = LookupRoute (dst, p);
+      if (!route)
+        {
+          NS_LOG_LOGIC ("No route to " << dst << ", drop packet " << p->GetUid ());
+          errcb (p, header, Socket::ERROR_NOROUTETOHOST);
+          return true;
+        }
+      NS_LOG_LOGIC ("Forwarding packet " << p->GetUid () << " to " << dst << " through " << route->GetGateway ());
+      ufcb (route, p, header);
+      return true;
+    }
+
+    Ptr<Ipv4Route>
+    RoutingProtocol::RouteToBeacon (Ipv4Address dst) const
+    {
+      Ptr<Ipv4Route> route;
+      BeaconInfo const *info = m_disTable.Find (dst);
+      if (!info || info->GetNextHop () == Ipv4Address ())
+        {
+          return route;
+        }
+      return MakeRoute (dst, info->GetNextHop (), info->GetInterface ());
     }
 
+    Ptr<Ipv4Route>
+    RoutingProtocol::GeographicRoute (Ipv4Address dst) const
+    {
+      Ptr<Ipv4Route> route;
+      Position target;
+      if (!m_geoForwarding || !m_locations || !m_locations->GetPosition (dst, target))
+        {
+          return route;
+        }
 
+      Time cutoff = Simulator::Now () - m_neighborLifetime;
+      NeighborTable::Neighbor const *next = m_neighbors.Find (dst);
+      if (!next || next->heardAt <= cutoff)
+        {
+          //Progress is measured from the position we last advertised, rounded like the HELLO carried it,
+          //as our neighbors measure theirs: every greedy hop then gets strictly closer and can not loop
+          if (!m_helloRound || !m_helloRound->key.hasSenderPosition)
+            {
+              return route;
+            }
+          Position self (float (m_helloRound->key.senderPosition.first), float (m_helloRound->key.senderPosition.second));
+          next = m_neighbors.GetClosestTo (target, self, cutoff);
+        }
+      if (!next)
+        {
+          NS_LOG_LOGIC ("No neighbor closer to " << dst << " than this node");
+          return route;
+        }
+      return MakeRoute (dst, next->address, next->interface);
+    }
+
+    Ptr<Ipv4Route>
+    RoutingProtocol::LookupRoute (Ipv4Address dst, Ptr<const Packet> p) const
+    {
+      //A packet that met a greedy dead end stays on the gradient, switching back and forth could loop
+      GradientTag tag;
+      bool onGradient = p->PeekPacketTag (tag);
+      Ptr<Ipv4Route> route;
+      if (!onGradient)
+        {
+          route = GeographicRoute (dst);
+          if (route)
+            {
+              return route;
+            }
+        }
+      route = RouteToBeacon (dst);
+      if (route && m_geoForwarding && !onGradient)
+        {
+          p->AddPacketTag (tag);
+        }
+      return route;
+    }
+
+    Ptr<Ipv4Route>
+    RoutingProtocol::MakeRoute (Ipv4Address dst, Ipv4Address gateway, uint32_t ifIndex) const
+    {
+      Ptr<Ipv4Route> route;
+      if (ifIndex >= m_interfaces.size () || !m_interfaces[ifIndex].socket)
+        {
+          //The interface the neighbor was heard on is gone
+          return route;
+        }
+
+      route = Create<Ipv4Route> ();
+      route->SetDestination (dst);
+      route->SetGateway (gateway);
+      route->SetSource (m_interfaces[ifIndex].iface.GetLocal ());
+      route->SetOutputDevice (m_interfaces[ifIndex].device);
+      return route;
+    }
+
+
+
+    bool
+    RoutingProtocol::IsFullHelloRound () const
+    {
+      switch (m_helloMode)
+        {
+        case DELTA_HELLO:
+          return false;
+        case HYBRID_HELLO:
+          return Simulator::Now () - m_lastFullHello >= m_fullRefreshInterval;
+        default:
+          return true;
+        }
+    }
 
     void
     RoutingProtocol::SendHello ()
     {
       //NS_LOG_FUNCTION (this);
-      /* Broadcast a HELLO packet the message fields set as follows:
-   *   Sequence Number    The node's latest sequence number.
-   *   Hop Count                      0
+      /* Broadcast HELLO packets carrying one entry per advertised beacon, the entries are
+   * packed in as few packets as the MTU of the interface allows:
+   *   Sequence Number    The latest sequence number originated by the beacon.
+   *   Hop Count          Hops to the beacon (0 if this node is the beacon)
    */
 
-      for(std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin(); j != m_socketAddresses.end (); ++j)
+      //On delta rounds only the entries changed since the last HELLO are sent,
+      //a neighbor missing positions gets the whole table
+      bool fullHello = IsFullHelloRound () || m_positionRequested;
+
+      UpdateOwnHopSize ();
+
+      /*If this node is a beacon, it should broadcast its position always*/
+      //Delta rounds only carry changes, with aging the beacon must still refresh every table before it expires
+      bool advertiseSelf = m_isBeacon && (fullHello || m_ownInfoChanged || IsRefreshDue (m_lastSelfAdvertised));
+      if (advertiseSelf)
         {
-          Ptr<Socket> socket = j->first;
-          Ipv4InterfaceAddress iface = j->second;
-          /*TODO: Remove the hardcoded position*/
+          m_seqNo++;
+          m_lastSelfAdvertised = Simulator::Now ();
+        }
 
-          std::vector<Ipv4Address> knownBeacons = m_disTable.GetKnownBeacons ();
-          std::vector<Ipv4Address>::const_iterator addr;
-          for (addr = knownBeacons.begin (); addr != knownBeacons.end (); ++addr)
+      HelloKey key;
+      key.tableVersion = m_disTable.GetVersion ();
+      key.dirtyVersion = fullHello ? 0 : m_disTable.GetDirtyVersion ();
+      key.compact = m_compactHello;
+      key.resolution = m_positionResolution;
+      key.interned = m_internPositions;
+      key.fullHello = fullHello;
+      key.positionRequested = m_positionRequested;
+      key.ownInfoChanged = m_ownInfoChanged;
+      key.advertiseSelf = advertiseSelf;
+      key.posVersion = m_posVersion;
+      key.x = m_xPosition;
+      key.y = m_yPosition;
+      key.requestPositions = m_requestPositions;
+      key.sendHopSize = m_hasHopSize && m_hopSizeHops < m_hopSizeScope && (fullHello || m_hopSizeDirty);
+      key.hopSize = m_hopSize;
+      key.hopSizeBeacon = m_hopSizeBeacon;
+      key.hopSizeHops = m_hopSizeHops;
+      key.hopSizeSeqNo = m_hopSizeSeqNo;
+      key.hasSenderPosition = false;
+      if (m_geoForwarding && GetOwnPosition (key.senderPosition))
+        {
+          key.hasSenderPosition = true;
+          PublishPosition (key.senderPosition);
+          m_neighbors.Purge (Simulator::Now () - m_neighborLifetime);
+        }
+
+      //Snapshot of the round, every interface serializes the same information.
+      //An unchanged round is resent as is, so are the packets each interface serialized for it.
+      //The beacons bump their sequence numbers every full round, those are patched in
+      if (!m_helloRound || !(m_helloRound->key == key))
+        {
+          if (!m_helloRound || m_helloRound->GetReferenceCount () > 1)
             {
-              //Create a HELLO Packet for each known Beacon to this node
-              Position beaconPos = m_disTable.GetBeaconPosition (*addr);
-              FloodingHeader helloHeader(beaconPos.first,              //X Position
-                                         beaconPos.second,             //Y Position
-                                         m_seqNo++,                    //Sequence Numbr
-                                         m_disTable.GetHopsTo (*addr), //Hop Count
-                                         *addr);                       //Beacon Address
-              NS_LOG_DEBUG (iface.GetLocal ()<< " Sending Hello...");
-              Ptr<Packet> packet = Create<Packet>();
-              packet->AddHeader (helloHeader);
-              // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
-              Ipv4Address destination;
-              if (iface.GetMask () == Ipv4Mask::GetOnes ())
-                {
-                  destination = Ipv4Address ("255.255.255.255");
-                }
-              else
+              //Still queued for an interface, do not change it under the pending events
+              m_helloRound = Create<HelloRound> ();
+            }
+          FillHelloRound (*m_helloRound, key);
+          m_helloRound->id = ++m_helloRoundId;
+        }
+      else
+        {
+          //Same layout, a copy keeps the id so the interfaces keep their serialized HELLOs
+          Ptr<HelloRound> round = m_helloRound;
+          if (round->GetReferenceCount () > 1)
+            {
+              round = Create<HelloRound> (*m_helloRound);
+            }
+          if (RefreshSeqNos (*round))
+            {
+              m_helloRound = round;
+              if (key.compact)
                 {
-                  destination = iface.GetBroadcast ();
+                  //Varint deltas can not be patched, serialize again
+                  m_helloRound->id = ++m_helloRoundId;
                 }
-              Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
-              Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
             }
+        }
 
-          /*If this node is a beacon, it should broadcast its position always*/
-          NS_LOG_DEBUG ("Node "<< iface.GetLocal () << " isBeacon? " << m_isBeacon);
-          if (m_isBeacon){
-              //Create a HELLO Packet for each known Beacon to this node
-              FloodingHeader helloHeader(m_xPosition,                 //X Position
-                                         m_yPosition,                 //Y Position
-                                         m_seqNo++,                   //Sequence Numbr
-                                         0,                           //Hop Count
-                                         iface.GetLocal ());          //Beacon Address
-              std::cout <<__FILE__<< __LINE__ << helloHeader << std::endl;
-
-              NS_LOG_DEBUG (iface.GetLocal ()<< " Sending Hello...");
-              Ptr<Packet> packet = Create<Packet>();
-              packet->AddHeader (helloHeader);
-              // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
-              Ipv4Address destination;
-              if (iface.GetMask () == Ipv4Mask::GetOnes ())
-                {
-                  destination = Ipv4Address ("255.255.255.255");
-                }
-              else
-                {
-                  destination = iface.GetBroadcast ();
-                }
-              Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
-              Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
+      for (uint32_t i = 0; i < m_interfaces.size (); i++)
+        {
+          if (!m_interfaces[i].socket)
+            {
+              continue;
+            }
+          Time jitter = Time (MilliSeconds (m_URandom->GetInteger (0, 10)));
+          Simulator::Schedule (jitter, &RoutingProtocol::SendHelloOn, this, i, Ptr<const HelloRound> (m_helloRound));
+        }
 
+      //Everything pending was advertised on every interface
+      m_disTable.ClearDirty ();
+      m_ownInfoChanged = false;
+      m_positionRequested = false;
+      m_requestPositions = false;
+      m_hopSizeDirty = false;
+      m_lastHelloSent = Simulator::Now ();
+      if (fullHello)
+        {
+          m_lastFullHello = Simulator::Now ();
+        }
+    }
+
+    bool
+    RoutingProtocol::HelloKey::operator== (HelloKey const &other) const
+    {
+      return tableVersion == other.tableVersion && compact == other.compact
+          && resolution == other.resolution && interned == other.interned && fullHello == other.fullHello
+          && positionRequested == other.positionRequested && ownInfoChanged == other.ownInfoChanged
+          && advertiseSelf == other.advertiseSelf && dirtyVersion == other.dirtyVersion
+          && posVersion == other.posVersion && x == other.x && y == other.y
+          && requestPositions == other.requestPositions && sendHopSize == other.sendHopSize
+          && hopSize == other.hopSize && hopSizeBeacon == other.hopSizeBeacon
+          && hopSizeHops == other.hopSizeHops && hopSizeSeqNo == other.hopSizeSeqNo
+          && hasSenderPosition == other.hasSenderPosition
+          && (!hasSenderPosition || senderPosition == other.senderPosition);
+    }
 
+    void
+    RoutingProtocol::FillHelloRound (HelloRound &round, HelloKey const &key) const
+    {
+      round.key = key;
+      round.sendHopSize = key.sendHopSize;
+      round.hopSize = key.hopSize;
+      round.hopSizeBeacon = key.hopSizeBeacon;
+      round.hopSizeHops = key.hopSizeHops;
+      round.hopSizeSeqNo = key.hopSizeSeqNo;
+      round.requestPositions = key.requestPositions;
+
+      //clear keeps the capacity of the previous rounds
+      round.entries.clear ();
+      for (DistanceTable::Iterator it = m_disTable.Begin (); it != m_disTable.End (); ++it)
+        {
+          BeaconInfo const &info = it->second;
+          if (!key.fullHello && !info.IsDirty ())
+            {
+              continue;
             }
+          //Create a HELLO entry for each advertised Beacon
+          FloodingHeader entry (info.GetPosition ().first,    //X Position
+                                info.GetPosition ().second,   //Y Position
+                                info.GetSeqNo (),             //Beacon's sequence number
+                                info.GetHops (),              //Hop Count
+                                it->first);                   //Beacon Address
+          entry.SetPositionVersion (info.GetPositionVersion ());
+          entry.SetHasPosition (!key.interned || key.positionRequested || info.IsPositionPending ());
+          round.entries.push_back (entry);
+        }
+
+      round.advertiseSelf = key.advertiseSelf;
+      if (round.advertiseSelf)
+        {
+          round.self = FloodingHeader (key.x,            //X Position
+                                       key.y,            //Y Position
+                                       m_seqNo,          //Sequence Numbr
+                                       0,                //Hop Count
+                                       Ipv4Address ());  //Beacon Address, set per interface
+          round.self.SetPositionVersion (key.posVersion);
+          round.self.SetHasPosition (!key.interned || key.positionRequested || key.ownInfoChanged);
         }
     }
 
+    bool
+    RoutingProtocol::RefreshSeqNos (HelloRound &round) const
+    {
+      //Both follow the address order, and an equal key means the same entries
+      bool changed = false;
+      DistanceTable::Iterator it = m_disTable.Begin ();
+      for (std::vector<FloodingHeader>::iterator entry = round.entries.begin (); entry != round.entries.end (); ++entry)
+        {
+          while (it != m_disTable.End () && it->first < entry->GetBeaconAddress ())
+            {
+              ++it;
+            }
+          if (it != m_disTable.End () && it->first == entry->GetBeaconAddress ()
+              && it->second.GetSeqNo () != entry->GetSequenceNumber ())
+            {
+              entry->SetSequenceNumber (it->second.GetSeqNo ());
+              changed = true;
+            }
+        }
+      if (round.advertiseSelf && round.self.GetSequenceNumber () != m_seqNo)
+        {
+          round.self.SetSequenceNumber (m_seqNo);
+          changed = true;
+        }
+      return changed;
+    }
+
+    void
+    RoutingProtocol::UpdateOwnHopSize ()
+    {
+      if (!m_isBeacon || m_disTable.GetSize () == 0 || m_socketAddresses.empty ())
+        {
+          return;
+        }
+      if (Simulator::Now () - m_lastTableChange < m_hopSizeHoldTime)
+        {
+          //Wait for the table to settle
+          return;
+        }
+
+      //Average distance per hop to every other beacon we know
+      double distance = 0;
+      uint32_t hops = 0;
+      for (DistanceTable::Iterator it = m_disTable.Begin (); it != m_disTable.End (); ++it)
+        {
+          double dx = m_xPosition - it->second.GetPosition ().first;
+          double dy = m_yPosition - it->second.GetPosition ().second;
+          distance += std::sqrt (dx * dx + dy * dy);
+          hops += it->second.GetHops ();
+        }
+      double hopSize = distance / hops;
+      if (m_hasHopSize && std::fabs (hopSize - m_hopSize) < 1e-3)
+        {
+          return;
+        }
+
+      NS_LOG_DEBUG ("Beacon hop size " << hopSize);
+      m_hasHopSize = true;
+      m_hopSize = hopSize;
+      m_hopSizeBeacon = m_socketAddresses.begin ()->second.GetLocal ();
+      m_hopSizeHops = 0;
+      m_hopSizeSeqNo++;
+      m_hopSizeDirty = true;
+      m_hopSizeTrace (m_hopSizeBeacon, m_hopSize, m_hopSizeHops);
+    }
+
+    bool
+    RoutingProtocol::UpdateHopSize (HelloHeader const &helloHeader)
+    {
+      if (!helloHeader.HasHopSize () || m_isBeacon)
+        {
+          return false;
+        }
+
+      //Keep the hop size of the nearest beacon, and its updates
+      uint16_t hops = helloHeader.GetHopSizeHops () + 1;
+      bool accept;
+      if (!m_hasHopSize)
+        {
+          accept = true;
+        }
+      else if (helloHeader.GetHopSizeBeacon () == m_hopSizeBeacon)
+        {
+          accept = IsNewerSeqNo (helloHeader.GetHopSizeSeqNo (), m_hopSizeSeqNo)
+              || (helloHeader.GetHopSizeSeqNo () == m_hopSizeSeqNo && hops < m_hopSizeHops);
+        }
+      else
+        {
+          accept = hops < m_hopSizeHops;
+        }
+      if (!accept)
+        {
+          return false;
+        }
+
+      NS_LOG_DEBUG ("Hop size " << helloHeader.GetHopSize () << " from " << helloHeader.GetHopSizeBeacon () << ", " << hops << " hops");
+      m_hasHopSize = true;
+      m_hopSize = helloHeader.GetHopSize ();
+      m_hopSizeBeacon = helloHeader.GetHopSizeBeacon ();
+      m_hopSizeHops = hops;
+      m_hopSizeSeqNo = helloHeader.GetHopSizeSeqNo ();
+      m_hopSizeDirty = true;
+      m_hopSizeTrace (m_hopSizeBeacon, m_hopSize, m_hopSizeHops);
+      return true;
+    }
+
+    void
+    RoutingProtocol::SendHelloOn (uint32_t ifIndex, Ptr<const HelloRound> round)
+    {
+      if (ifIndex >= m_interfaces.size () || !m_interfaces[ifIndex].socket)
+        {
+          //The interface went down after the round was scheduled
+          return;
+        }
+      InterfaceState &state = m_interfaces[ifIndex];
+      if (state.helloRound != round->id)
+        {
+          BuildHellos (state, *round);
+        }
+      for (size_t i = 0; i < state.hellos.size (); i++)
+        {
+          //The socket takes ownership of what it sends, the serialized HELLO is kept
+          SendHelloPacket (state.socket, state.iface, GetHelloPacket (state.hellos[i], *round), state.hellos[i].entries);
+        }
+    }
+
+    void
+    RoutingProtocol::BuildHellos (InterfaceState &state, HelloRound const &round)
+    {
+      Ipv4InterfaceAddress const &iface = state.iface;
+      state.helloRound = round.id;
+      state.hellos.clear ();
+
+      //Fill each HELLO up to the interface MTU
+      int32_t  ifIndex = m_ipv4->GetInterfaceForAddress (iface.GetLocal ());
+      uint32_t payloadSize = m_ipv4->GetMtu (ifIndex) - Ipv4Header ().GetSerializedSize () - UdpHeader ().GetSerializedSize ();
+
+      //Reset the scratch header, Clear keeps the capacity of its entries
+      HelloHeader &helloHeader = m_helloHeader;
+      helloHeader.Clear ();
+      helloHeader.ClearHopSize ();
+      helloHeader.ClearSenderPosition ();
+      helloHeader.SetCompact (round.key.compact, round.key.resolution);
+      helloHeader.SetInterned (round.key.interned);
+      helloHeader.SetPositionRequest (round.requestPositions);
+      if (round.sendHopSize)
+        {
+          helloHeader.SetHopSize (m_isBeacon ? iface.GetLocal () : round.hopSizeBeacon,
+                                  round.hopSize, round.hopSizeHops, round.hopSizeSeqNo);
+        }
+      if (round.key.hasSenderPosition)
+        {
+          helloHeader.SetSenderPosition (round.key.senderPosition.first, round.key.senderPosition.second);
+        }
+      uint16_t maxEntries = helloHeader.GetMaxEntries (payloadSize);
+
+      std::vector<FloodingHeader> const &entries = round.entries;
+      size_t total = entries.size () + (round.advertiseSelf ? 1 : 0);
+      uint32_t first = 0;
+      for (size_t i = 0; i < total; i++)
+        {
+          if (i < entries.size ())
+            {
+              helloHeader.AddEntry (entries[i]);
+            }
+          else
+            {
+              FloodingHeader self = round.self;
+              self.SetBeaconAddress (iface.GetLocal ());
+              NS_LOG_DEBUG ("Advertising " << self);
+              helloHeader.AddEntry (self);
+            }
+          if (helloHeader.GetEntryCount () == maxEntries)
+            {
+              AddHello (state, helloHeader, first);
+              helloHeader.Clear ();
+              first = i + 1;
+            }
+        }
+      //An empty HELLO is still sent to ask for missing positions or carry the hop size or our position
+      if (helloHeader.GetEntryCount () > 0 || (total == 0 && (round.requestPositions || round.sendHopSize || round.key.hasSenderPosition)))
+        {
+          AddHello (state, helloHeader, first);
+        }
+    }
+
+    void
+    RoutingProtocol::AddHello (InterfaceState &state, HelloHeader const &helloHeader, uint32_t first)
+    {
+      state.hellos.push_back (CachedHello ());
+      CachedHello &hello = state.hellos.back ();
+      hello.packet = Create<Packet> ();
+      hello.packet->AddHeader (helloHeader);
+      hello.first = first;
+      hello.entries = helloHeader.GetEntryCount ();
+      hello.networkOrder = false;
+      if (hello.entries > 0 && helloHeader.GetSequenceNumberOffsets (hello.seqNoOffsets, hello.networkOrder))
+        {
+          hello.bytes.resize (hello.packet->GetSize ());
+          hello.packet->CopyData (&hello.bytes[0], hello.bytes.size ());
+        }
+    }
+
+    Ptr<Packet>
+    RoutingProtocol::GetHelloPacket (CachedHello &hello, HelloRound const &round) const
+    {
+      if (hello.seqNoOffsets.empty ())
+        {
+          return hello.packet->Copy ();
+        }
+      for (uint32_t i = 0; i < hello.seqNoOffsets.size (); i++)
+        {
+          uint32_t index = hello.first + i;
+          uint16_t seqNo = index < round.entries.size () ? round.entries[index].GetSequenceNumber ()
+                                                         : round.self.GetSequenceNumber ();
+          HelloHeader::WriteSequenceNumber (&hello.bytes[0], hello.seqNoOffsets[i], seqNo, hello.networkOrder);
+        }
+      return Create<Packet> (&hello.bytes[0], hello.bytes.size ());
+    }
+
+    void
+    RoutingProtocol::SendHelloPacket (Ptr<Socket> socket, Ipv4InterfaceAddress iface, Ptr<Packet> packet, uint32_t entries)
+    {
+      NS_LOG_DEBUG (iface.GetLocal ()<< " Sending Hello with " << entries << " entries...");
+      m_helloTxTrace (entries, packet->GetSize ());
+      m_stats.helloTx++;
+      m_stats.bytesTx += packet->GetSize ();
+      m_stats.entriesAdvertised += entries;
+      // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
+      Ipv4Address destination;
+      if (iface.GetMask () == Ipv4Mask::GetOnes ())
+        {
+          destination = Ipv4Address ("255.255.255.255");
+        }
+      else
+        {
+          destination = iface.GetBroadcast ();
+        }
+      SendTo (socket, packet, destination);
+    }
 
     void
     RoutingProtocol::SendTo (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination)
@@ -512,17 +1277,224 @@ namespace ns3 {
       Ipv4Address sender = inetSourceAddr.GetIpv4 ();
       Ipv4Address receiver = m_socketAddresses[socket].GetLocal ();
 
+      int32_t ifIndex = m_ipv4->GetInterfaceForAddress (receiver);
+
       NS_LOG_DEBUG ("sender:           " << sender);
       NS_LOG_DEBUG ("receiver:         " << receiver);
 
 
-      FloodingHeader fHeader;
-      packet->RemoveHeader (fHeader);
-      NS_LOG_DEBUG ("Update the entry for: " << fHeader.GetBeaconAddress ());
-      UpdateHopsTo (fHeader.GetBeaconAddress (), fHeader.GetHopCount () + 1, fHeader.GetXPosition (), fHeader.GetYPosition ());
+      HelloHeader helloHeader;
+      uint32_t bytes = packet->GetSize ();
+      packet->RemoveHeader (helloHeader);
+      m_helloRxTrace (sender, helloHeader.GetEntryCount (), bytes);
+      m_stats.helloRx++;
+      m_stats.bytesRx += bytes;
 
+      //The HELLO is consistent if it neither improves our table nor could be improved by it
+      bool consistent = true;
+      if (helloHeader.IsPositionRequest ())
+        {
+          NS_LOG_DEBUG (sender << " is missing beacon positions");
+          m_positionRequested = true;
+          consistent = false;
+        }
+      if (UpdateHopSize (helloHeader))
+        {
+          consistent = false;
+          m_estimateDirty = true;
+        }
+      if (m_geoForwarding && helloHeader.HasSenderPosition () && ifIndex >= 0)
+        {
+          m_neighbors.Update (sender, Position (helloHeader.GetSenderX (), helloHeader.GetSenderY ()), ifIndex);
+        }
 
+      std::vector<FloodingHeader> const &entries = helloHeader.GetEntries ();
+      for (std::vector<FloodingHeader>::const_iterator fHeader = entries.begin (); fHeader != entries.end (); ++fHeader)
+        {
+          Ipv4Address beacon = fHeader->GetBeaconAddress ();
+          uint16_t hops = fHeader->GetHopCount () + 1;
+          uint16_t seqNo = fHeader->GetSequenceNumber ();
+          if (m_ipv4->GetInterfaceForAddress (beacon) >= 0)
+            {
+              //Our own entry coming back from a neighbor
+              continue;
+            }
+
+          //Drop old and duplicated information before touching the table, the next hop may still confirm our entry
+          BeaconInfo const *known = m_disTable.Find (beacon);
+          if (known && !IsNewerSeqNo (seqNo, known->GetSeqNo ())
+              && !(seqNo == known->GetSeqNo () && (hops < known->GetHops () || sender == known->GetNextHop ())))
+            {
+              NS_LOG_DEBUG ("Stale entry for " << beacon << ", seqNo " << seqNo << " hops " << hops);
+              m_staleEntryTrace (beacon, hops);
+              m_stats.updatesIgnored++;
+              if (known->GetHops () + 1 < fHeader->GetHopCount ())
+                {
+                  consistent = false;
+                }
+              continue;
+            }
 
+          double x = fHeader->GetXPosition ();
+          double y = fHeader->GetYPosition ();
+          if (!fHeader->HasPosition ())
+            {
+              //Interned entry, the position must already be in our table
+              if (!known || known->GetPositionVersion () != fHeader->GetPositionVersion ())
+                {
+                  NS_LOG_DEBUG ("Unknown position for " << beacon << ", requesting it");
+                  m_requestPositions = true;
+                  consistent = false;
+                  m_stats.updatesIgnored++;
+                  continue;
+                }
+              x = known->GetPosition ().first;
+              y = known->GetPosition ().second;
+            }
+
+          NS_LOG_DEBUG ("Update the entry for: " << beacon);
+          UpdateResult result = UpdateHopsTo (beacon, hops, x, y, seqNo, fHeader->GetPositionVersion (), sender, ifIndex);
+          if (result == ENTRY_STALE)
+            {
+              m_stats.updatesIgnored++;
+            }
+          else
+            {
+              m_stats.updatesApplied++;
+            }
+          if (result == ENTRY_INSERTED || result == ENTRY_CHANGED)
+            {
+              consistent = false;
+              m_lastTableChange = Simulator::Now ();
+              m_estimateDirty = true;
+            }
+        }
+
+      UpdateEstimate ();
+
+      if (consistent)
+        {
+          m_trickleCounter++;
+        }
+      else
+        {
+          TrickleReset ();
+        }
+    }
+
+    void
+    RoutingProtocol::UpdateEstimate ()
+    {
+      if (!m_estimateDirty || m_isBeacon)
+        {
+          return;
+        }
+      m_estimateDirty = false;
+
+      Position estimate;
+      if (!m_hasHopSize || !m_localizer.Localize (m_disTable, m_hopSize, estimate))
+        {
+          return;
+        }
+      if (m_hasEstimate && estimate == m_estimate)
+        {
+          return;
+        }
+      m_hasEstimate = true;
+      m_estimate = estimate;
+      NS_LOG_DEBUG ("Estimated position " << estimate.first << ", " << estimate.second);
+      m_estimateTrace (estimate.first, estimate.second);
+    }
+
+    bool
+    RoutingProtocol::GetOwnPosition (Position &position) const
+    {
+      if (m_isBeacon)
+        {
+          position = Position (m_xPosition, m_yPosition);
+          return true;
+        }
+      if (m_hasEstimate)
+        {
+          position = m_estimate;
+          return true;
+        }
+      return false;
+    }
+
+    void
+    RoutingProtocol::PublishPosition (Position const &position)
+    {
+      if (!m_locations || (m_positionPublished && position == m_publishedPosition))
+        {
+          return;
+        }
+      for (size_t i = 0; i < m_interfaces.size (); i++)
+        {
+          if (m_interfaces[i].socket)
+            {
+              m_locations->SetPosition (m_interfaces[i].iface.GetLocal (), position);
+            }
+        }
+      m_positionPublished = true;
+      m_publishedPosition = position;
+    }
+
+    Statistics
+    RoutingProtocol::GetStatistics () const
+    {
+      Statistics stats = m_stats;
+      stats.lastTableChange = m_lastTableChange;
+      stats.tableSize = m_disTable.GetSize ();
+      return stats;
+    }
+
+    void
+    RoutingProtocol::WarmStart (DistanceTable const &table, SnapshotNode const &state)
+    {
+      NS_LOG_FUNCTION (this << state.node);
+      m_disTable = table;
+      //Every neighbor was loaded from the same snapshot, nothing is left to advertise
+      m_disTable.ClearDirty ();
+      m_lastTableChange = Simulator::Now ();
+      m_helloRound = 0;
+
+      //Keep the sequence numbers the other tables hold, or our new HELLOs would look stale to them
+      if (m_isBeacon && (state.flags & SnapshotNode::BEACON))
+        {
+          m_seqNo = state.seqNo;
+          m_posVersion = state.posVersion;
+        }
+      m_ownInfoChanged = false;
+
+      m_hasHopSize = (state.flags & SnapshotNode::HAS_HOP_SIZE) != 0;
+      m_hopSize = state.hopSize;
+      m_hopSizeBeacon = Ipv4Address (state.hopSizeBeacon);
+      m_hopSizeHops = state.hopSizeHops;
+      m_hopSizeSeqNo = state.hopSizeSeqNo;
+      m_hopSizeDirty = false;
+
+      //Straight to the localization phase, with HELLOs backed off as if the tables had converged here
+      m_estimateDirty = true;
+      UpdateEstimate ();
+      if (m_enableTrickle && m_ipv4)
+        {
+          m_trickleInterval = GetTrickleImax ();
+          TrickleStartInterval ();
+        }
+    }
+
+    bool
+    RoutingProtocol::GetEstimatedPosition (Position &estimate)
+    {
+      if (m_isBeacon)
+        {
+          estimate = Position (m_xPosition, m_yPosition);
+          return true;
+        }
+      UpdateEstimate ();
+      estimate = m_estimate;
+      return m_hasEstimate;
     }
 
     Ptr<Socket>
@@ -541,21 +1513,47 @@ namespace ns3 {
       return socket;
     }
 
-    void
-    RoutingProtocol::UpdateHopsTo (Ipv4Address beacon, uint16_t newHops, double x, double y)
+    UpdateResult
+    RoutingProtocol::UpdateHopsTo (Ipv4Address beacon, uint16_t newHops, double x, double y, uint16_t seqNo, uint8_t posVersion,
+                                   Ipv4Address nextHop, uint32_t interface)
     {
-      uint16_t oldHops = m_disTable.GetHopsTo (beacon);
-      if (m_ipv4->GetInterfaceForAddress (beacon) >= 0){
-          NS_LOG_DEBUG ("Local Address, not updating in table");
-          return;
+      BeaconInfo const *info = m_disTable.Find (beacon);
+      if (!info)
+        {
+          m_disTable.AddBeacon (beacon, newHops, x, y, seqNo, posVersion, nextHop, interface);
+          m_tableUpdateTrace (beacon, 0, newHops);
+          return ENTRY_INSERTED;
         }
 
-      if( oldHops > newHops || oldHops == 0) //Update only when a shortest path is found
-        m_disTable.AddBeacon (beacon, newHops, x, y);
-    }
+      uint16_t oldHops = info->GetHops ();
+      bool newer = IsNewerSeqNo (seqNo, info->GetSeqNo ());
+      bool fromNextHop = nextHop == info->GetNextHop ();
+      //Same sequence number: only a shorter path, or the next hop confirming the entry
+      if (newer || (seqNo == info->GetSeqNo () && (newHops < oldHops || fromNextHop)))
+        {
+          //A longer path with a newer sequence number means the topology changed if it comes from our next hop.
+          //From another neighbor it usually only relayed the round first, or our next hop lost a HELLO
+          if (newer && newHops > oldHops && !fromNextHop && Simulator::Now () - info->GetTime () < m_settlingTime)
+            {
+              NS_LOG_DEBUG ("Keeping the path to " << beacon << " through " << info->GetNextHop ());
+              m_disTable.RefreshSeqNo (beacon, seqNo);
+              return ENTRY_REFRESHED;
+            }
+
+          bool changed = oldHops != newHops
+              || info->GetPosition () != std::make_pair (x, y)
+              || info->GetPositionVersion () != posVersion;
+          m_disTable.AddBeacon (beacon, newHops, x, y, seqNo, posVersion, nextHop, interface);
+          if (changed)
+            {
+              m_tableUpdateTrace (beacon, oldHops, newHops);
+              return ENTRY_CHANGED;
+            }
+          return ENTRY_REFRESHED;
+        }
 
-    DistanceTable RoutingProtocol::GetDistanceTable() {
-      return m_disTable;
+      m_staleEntryTrace (beacon, newHops);
+      return ENTRY_STALE;
     }
   }
 }
@@ -12,8 +12,15 @@
 #include "ns3/timer.h"
 #include "ns3/packet.h"
 #include "ns3/ipv4-header.h"
+#include "ns3/traced-callback.h"
+#include "ns3/simple-ref-count.h"
 
 #include "distance-table.h"
+#include "dvhop-packet.h"
+#include "localizer.h"
+#include "neighbor-table.h"
+#include "location-registry.h"
+#include "distance-snapshot.h"
 
 #include <map>
 
@@ -21,6 +28,46 @@
 namespace ns3 {
   namespace dvhop{
 
+    /**
+     * Which entries of the DistanceTable are advertised on each HELLO round
+     */
+    enum HelloMode
+    {
+      FULL_HELLO,    //!< The whole table, every round
+      DELTA_HELLO,   //!< Only the entries changed since the previous round
+      HYBRID_HELLO   //!< Changed entries, plus the whole table every FullRefreshInterval
+    };
+
+    /**
+     * Outcome of processing one received HELLO entry
+     */
+    enum UpdateResult
+    {
+      ENTRY_STALE,      //!< Older sequence number, or same one without a shorter path or the next hop confirming it
+      ENTRY_REFRESHED,  //!< Newer sequence number or confirmed by the next hop, same hops and position
+      ENTRY_INSERTED,   //!< First information about the beacon
+      ENTRY_CHANGED     //!< Hops or position changed
+    };
+
+    /**
+     * Protocol counters of one node since the start of the simulation
+     */
+    struct Statistics
+    {
+      Statistics () : helloTx (0), bytesTx (0), helloRx (0), bytesRx (0), entriesAdvertised (0),
+                      updatesApplied (0), updatesIgnored (0), tableSize (0) {}
+
+      uint32_t helloTx;
+      uint64_t bytesTx;            //!< DV-Hop payload bytes, without UDP/IP headers
+      uint32_t helloRx;
+      uint64_t bytesRx;
+      uint64_t entriesAdvertised;  //!< Entries sent over all HELLOs
+      uint64_t updatesApplied;     //!< Received entries that inserted, changed or refreshed a table entry
+      uint64_t updatesIgnored;     //!< Received entries dropped as stale or without a known position
+      Time     lastTableChange;    //!< Last insertion, change or purge of a table entry
+      uint32_t tableSize;
+    };
+
     class RoutingProtocol : public Ipv4RoutingProtocol{
     public:
       static const uint32_t DVHOP_PORT;
@@ -49,8 +96,8 @@ namespace ns3 {
       int64_t AssignStreams(int64_t stream);
 
       //Getters and Setters for protocol parameters
-      void SetIsBeacon(bool isBeacon)    { m_isBeacon = isBeacon; }
-      void SetPosition(double x, double y) { m_xPosition = x; m_yPosition = y; }
+      void SetIsBeacon(bool isBeacon)    { m_isBeacon = isBeacon; m_ownInfoChanged = true; }
+      void SetPosition(double x, double y) { m_xPosition = x; m_yPosition = y; m_posVersion = (m_posVersion + 1) & 0x7f; m_ownInfoChanged = true; }
 
       double GetXPosition()               { return m_xPosition;}
       double GetYPosition()               { return m_yPosition;}
@@ -58,7 +105,50 @@ namespace ns3 {
       bool  IsBeacon()                   { return m_isBeacon;}
 
       void  PrintDistances(Ptr<OutputStreamWrapper> stream, Ptr<Node> node) const;
-      DistanceTable  GetDistanceTable();
+
+      //Average hop distance (correction factor) from the nearest beacon, or computed by this beacon
+      bool        HasHopSize() const          { return m_hasHopSize; }
+      double      GetHopSize() const          { return m_hopSize; }
+      Ipv4Address GetHopSizeBeacon() const    { return m_hopSizeBeacon; }
+      uint16_t    GetHopSizeHops() const      { return m_hopSizeHops; }
+      uint16_t    GetHopSizeSeqNo() const     { return m_hopSizeSeqNo; }
+      DistanceTable const &  GetDistanceTable() const { return m_disTable; }
+
+      //Sequence number and position version of the beacon entry of this node
+      uint16_t    GetSequenceNumber() const   { return m_seqNo; }
+      uint8_t     GetPositionVersion() const  { return m_posVersion; }
+
+      /**
+       * @brief GetEstimatedPosition The position of this node estimated from its table and hop size,
+       *recomputed only if they changed since the last estimate. Beacons return their own position.
+       * @param estimate Set to the estimate on success
+       * @return False if the node can not localize itself yet
+       */
+      bool  GetEstimatedPosition(Position &estimate);
+
+      //Counters since the start of the simulation, with the current table size
+      Statistics  GetStatistics() const;
+
+      /**
+       * @brief WarmStart Replaces the state of this node with one saved from a converged run,
+       *so localization does not wait for the tables to be flooded again
+       * @param table The saved distance table, its entries are taken as already advertised
+       * @param state The saved sequence numbers and hop size
+       */
+      void  WarmStart(DistanceTable const &table, SnapshotNode const &state);
+
+      //Where destinations are looked up, and this node publishes its position, for geographic forwarding
+      void  SetLocationRegistry(Ptr<LocationRegistry> locations) { m_locations = locations; m_positionPublished = false; }
+      Ptr<LocationRegistry>  GetLocationRegistry() const  { return m_locations; }
+      NeighborTable const &  GetNeighborTable() const     { return m_neighbors; }
+
+      //Signatures of the trace sources
+      typedef void (* PositionTracedCallback)(double x, double y);
+      typedef void (* HelloTxTracedCallback)(uint32_t entries, uint32_t bytes);
+      typedef void (* HelloRxTracedCallback)(Ipv4Address sender, uint32_t entries, uint32_t bytes);
+      typedef void (* TableUpdateTracedCallback)(Ipv4Address beacon, uint16_t oldHops, uint16_t newHops);
+      typedef void (* StaleEntryTracedCallback)(Ipv4Address beacon, uint16_t hops);
+      typedef void (* HopSizeTracedCallback)(Ipv4Address beacon, double hopSize, uint16_t hops);
 
     private:
       //Start protocol operation
@@ -66,20 +156,171 @@ namespace ns3 {
       void        SendTo   (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
       void        RecvDvhop(Ptr<Socket> socket);
       Ptr<Socket> FindSocketWithInterfaceAddress (Ipv4InterfaceAddress iface) const;
-      //In case there exists a route to the destination, the packet is forwarded
+      //Forwards the packet if there exists a route to the destination, reports it through errcb otherwise
       bool        Forwarding(Ptr<const Packet> p, const Ipv4Header &header, UnicastForwardCallback ufcb, ErrorCallback errcb);
+      //Route toward a known beacon through the neighbor its entry was learned from, 0 if there is none
+      Ptr<Ipv4Route> RouteToBeacon(Ipv4Address dst) const;
+      //Geographic route if enabled and possible, the hop-count gradient otherwise. Marks the packet with a
+      //GradientTag when it leaves greedy forwarding and keeps a marked packet on the gradient
+      Ptr<Ipv4Route> LookupRoute(Ipv4Address dst, Ptr<const Packet> p) const;
+      Ptr<Ipv4Route> MakeRoute(Ipv4Address dst, Ipv4Address gateway, uint32_t ifIndex) const;
       void        SendUnicastTo(Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
 
       //HELLO intervals and timers
       Time   HelloInterval;
       Timer  m_htimer;
       void   SendHello();
+      bool   IsFullHelloRound() const;
       void   HelloTimerExpire();
 
+      //Everything the content of a HELLO round depends on but the sequence numbers, equal keys give
+      //the same HELLOs. Newer sequence numbers are patched into the round and its serialized HELLOs
+      struct HelloKey
+      {
+        uint32_t  tableVersion;
+        uint32_t  dirtyVersion;     //Only on delta rounds, full rounds advertise every entry
+        bool      compact;
+        double    resolution;
+        bool      interned;
+        bool      fullHello;
+        bool      positionRequested;
+        bool      ownInfoChanged;
+        bool      advertiseSelf;
+        uint8_t   posVersion;
+        double    x;
+        double    y;
+        bool      requestPositions;
+        bool      sendHopSize;
+        double    hopSize;
+        Ipv4Address hopSizeBeacon;
+        uint16_t  hopSizeHops;
+        uint16_t  hopSizeSeqNo;
+        bool      hasSenderPosition;
+        Position  senderPosition;
+        bool operator== (HelloKey const &other) const;
+      };
+      //What a HELLO round advertises, taken once and shared by the send event of every interface.
+      //It is kept between rounds and only refilled when its key changes
+      struct HelloRound : public SimpleRefCount<HelloRound>
+      {
+        uint32_t        id;
+        HelloKey        key;
+        std::vector<FloodingHeader> entries;
+        //Own beacon entry, its address is set per interface
+        bool            advertiseSelf;
+        FloodingHeader  self;
+        bool            requestPositions;
+        //Hop size block, the beacon address is set per interface on beacons
+        bool            sendHopSize;
+        double          hopSize;
+        Ipv4Address     hopSizeBeacon;
+        uint16_t        hopSizeHops;
+        uint16_t        hopSizeSeqNo;
+      };
+      void   FillHelloRound(HelloRound &round, HelloKey const &key) const;
+      //Brings the sequence numbers of an unchanged round up to date, false if none changed
+      bool   RefreshSeqNos(HelloRound &round) const;
+      Ptr<HelloRound> m_helloRound;
+      uint32_t        m_helloRoundId;
+      //Scratch header reused to serialize every HELLO
+      HelloHeader     m_helloHeader;
+      //One jittered event per interface and round, sending all its HELLOs back to back
+      void   SendHelloOn(uint32_t ifIndex, Ptr<const HelloRound> round);
+      void   SendHelloPacket(Ptr<Socket> socket, Ipv4InterfaceAddress iface, Ptr<Packet> packet, uint32_t entries);
+
+      //Which entries are advertised on each HELLO
+      HelloMode m_helloMode;
+      Time      m_fullRefreshInterval;
+      Time      m_lastFullHello;
+      //Marks if the beacon info of this node must be advertised on the next delta
+      bool      m_ownInfoChanged;
+      //With aging, beacons advertise themselves and every node sends a HELLO at least every third
+      //of m_entryLifetime, whatever the mode or the Trickle suppression
+      Time      m_lastSelfAdvertised;
+      Time      m_lastHelloSent;
+      bool      IsRefreshDue(Time lastSent) const;
+
+      //Encoding of the HELLO entries
+      bool     m_compactHello;
+      double   m_positionResolution;
+
+      //Position interning: positions are only sent when new, changed or requested
+      bool     m_internPositions;
+      uint8_t  m_posVersion;          //Version of this beacon's position
+      bool     m_positionRequested;   //A neighbor asked for positions
+      bool     m_requestPositions;    //We received entries for beacons with unknown position
+
+      //Trickle scheduling of the HELLOs (RFC 6206)
+      bool     m_enableTrickle;
+      Time     m_trickleImin;
+      Time     m_trickleImax;
+      uint32_t m_trickleK;           //Redundancy constant
+      Time     m_trickleInterval;    //Current interval length
+      uint32_t m_trickleCounter;     //Consistent HELLOs heard on the current interval
+      Timer    m_trickleTimer;       //Fires at the end of the current interval
+      void   TrickleStartInterval();
+      void   TrickleTimerExpire();
+      void   TrickleReset();
+      //m_trickleImax, capped at a third of m_entryLifetime with aging
+      Time   GetTrickleImax() const;
+
       //Table to store the hopCount to each beacon
       DistanceTable  m_disTable;
-      void UpdateHopsTo (Ipv4Address beacon, uint16_t hops, double x, double y);
+      //Time of the last change to the hops or positions in the table
+      Time   m_lastTableChange;
+      //A longer path with a newer sequence number from another neighbor than the next hop is only taken
+      //once the next hop did not confirm the entry for this long, a lost HELLO must not switch paths
+      Time   m_settlingTime;
+
+      //Second DV-Hop phase: beacons compute their hop size once the table is stable
+      //and flood it up to m_hopSizeScope hops, other nodes keep the one from the nearest beacon
+      Time        m_hopSizeHoldTime;
+      uint16_t    m_hopSizeScope;
+      bool        m_hasHopSize;
+      bool        m_hopSizeDirty;
+      double      m_hopSize;
+      Ipv4Address m_hopSizeBeacon;
+      uint16_t    m_hopSizeHops;
+      uint16_t    m_hopSizeSeqNo;
+      void        UpdateOwnHopSize();
+      bool        UpdateHopSize(HelloHeader const &helloHeader);
+
+      //Soft state: entries not refreshed for m_entryLifetime are purged by a single timer
+      Time   m_entryLifetime;
+      std::vector<DistanceTable::Entry> m_expired;   //Scratch list of the purged entries, for the trace
+      Timer  m_agingTimer;
+      void   AgingTimerExpire();
+      UpdateResult UpdateHopsTo (Ipv4Address beacon, uint16_t hops, double x, double y, uint16_t seqNo, uint8_t posVersion,
+                                 Ipv4Address nextHop, uint32_t interface);
+
+      //Own position estimate, recomputed at most once per HELLO when the table or the hop size changed
+      bool        m_estimateDirty;
+      bool        m_hasEstimate;
+      Position    m_estimate;
+      Localizer   m_localizer;
+      TracedCallback<double, double> m_estimateTrace;
+      void        UpdateEstimate();
+
+      //Greedy geographic forwarding toward the position the LocationRegistry gives for the destination,
+      //over the positions the neighbors attach to their HELLOs
+      bool        m_geoForwarding;
+      Time        m_neighborLifetime;
+      NeighborTable m_neighbors;
+      Ptr<LocationRegistry> m_locations;
+      bool        m_positionPublished;
+      Position    m_publishedPosition;
+      bool        GetOwnPosition(Position &position) const;
+      void        PublishPosition(Position const &position);
+      Ptr<Ipv4Route> GeographicRoute(Ipv4Address dst) const;
+
+      Statistics m_stats;
 
+      //Trace sources, free when nothing is connected
+      TracedCallback<uint32_t, uint32_t> m_helloTxTrace;
+      TracedCallback<Ipv4Address, uint32_t, uint32_t> m_helloRxTrace;
+      TracedCallback<Ipv4Address, uint16_t, uint16_t> m_tableUpdateTrace;
+      TracedCallback<Ipv4Address, uint16_t> m_staleEntryTrace;
+      TracedCallback<Ipv4Address, double, uint16_t> m_hopSizeTrace;
 
       //Boolean to identify if this node acts as a Beacon
       bool m_isBeacon;
@@ -92,8 +333,37 @@ namespace ns3 {
       Ptr<Ipv4>   m_ipv4;
       // Raw socket per each IP interface, map socket -> iface address (IP + mask)
       std::map< Ptr<Socket>, Ipv4InterfaceAddress > m_socketAddresses;
+      //A serialized HELLO, with where its sequence numbers are unless the encoding is compact
+      struct CachedHello
+      {
+        Ptr<Packet>           packet;
+        uint32_t              first;       //Index of its first entry in the round, the own entry comes last
+        uint32_t              entries;
+        std::vector<uint8_t>  bytes;
+        std::vector<uint32_t> seqNoOffsets;
+        bool                  networkOrder;
+      };
+      //Per-packet view of m_socketAddresses indexed by interface, with the device routes go out of
+      //and the HELLOs serialized for the last round, resent while the round does not change
+      struct InterfaceState
+      {
+        Ptr<Socket>           socket;
+        Ipv4InterfaceAddress  iface;
+        Ptr<NetDevice>        device;
+        uint32_t              helloRound;
+        std::vector<CachedHello> hellos;
+        InterfaceState () : helloRound (0) {}
+      };
+      std::vector<InterfaceState> m_interfaces;
+      void  UpdateInterfaces();
+      //Serializes the HELLOs of a round for an interface
+      void  BuildHellos(InterfaceState &state, HelloRound const &round);
+      void  AddHello(InterfaceState &state, HelloHeader const &helloHeader, uint32_t first);
+      //Copy of a cached HELLO carrying the sequence numbers of the round
+      Ptr<Packet> GetHelloPacket(CachedHello &hello, HelloRound const &round) const;
 
-      uint32_t    m_seqNo;
+      //Sequence number of this node's beacon entry, increased each time it is advertised
+      uint16_t    m_seqNo;
 
       //marks if the node is dead
       int m_isDead;
@@ -0,0 +1,199 @@
+#include "localizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    namespace
+    {
+      //Cached beacon sets before the cache is flushed, by default
+      const size_t MAX_CACHED_SETS = 4096;
+
+      //Orders the entries by hops, then by beacon address to keep the selection deterministic
+      struct FewerHops
+      {
+        bool operator() (DistanceTable::Entry const *a, DistanceTable::Entry const *b) const
+        {
+          if (a->second.GetHops () != b->second.GetHops ())
+            {
+              return a->second.GetHops () < b->second.GetHops ();
+            }
+          return a->first.Get () < b->first.Get ();
+        }
+      };
+
+      struct AddressBefore
+      {
+        bool operator() (DistanceTable::Entry const *a, DistanceTable::Entry const *b) const
+        {
+          return a->first.Get () < b->first.Get ();
+        }
+      };
+    }
+
+
+    Localizer::Localizer()
+      : m_maxBeacons (0),
+        m_maxCachedSets (MAX_CACHED_SETS)
+    {
+    }
+
+    bool
+    Localizer::Localize (DistanceTable const &table, double hopSize, Position &estimate)
+    {
+      m_selected.clear ();
+      for (DistanceTable::Iterator it = table.Begin (); it != table.End (); ++it)
+        {
+          m_selected.push_back (&*it);
+        }
+      if (m_maxBeacons > 0 && m_selected.size () > m_maxBeacons)
+        {
+          //Closer beacons have a smaller distance error
+          std::partial_sort (m_selected.begin (), m_selected.begin () + m_maxBeacons, m_selected.end (), FewerHops ());
+          m_selected.resize (m_maxBeacons);
+          //Same beacons, same order, same cache entry
+          std::sort (m_selected.begin (), m_selected.end (), AddressBefore ());
+        }
+
+      m_positions.clear ();
+      m_ranges.clear ();
+      for (size_t i = 0; i < m_selected.size (); i++)
+        {
+          m_positions.push_back (m_selected[i]->second.GetPosition ());
+          m_ranges.push_back (hopSize * m_selected[i]->second.GetHops ());
+        }
+      return Localize (m_positions, m_ranges, estimate);
+    }
+
+    bool
+    Localizer::Localize (std::vector<Position> const &beacons, std::vector<double> const &ranges, Position &estimate)
+    {
+      if (beacons.size () < 3 || beacons.size () != ranges.size ())
+        {
+          return false;
+        }
+
+      Solver const &solver = GetSolver (beacons);
+      if (!solver.valid)
+        {
+          return false;
+        }
+
+      //b_i = r_n² - r_i² + |p_i - p_n|², p = (AᵀA)⁻¹Aᵀ b
+      size_t n = beacons.size () - 1;
+      double rn2 = ranges[n] * ranges[n];
+      double x = 0;
+      double y = 0;
+      for (size_t i = 0; i < n; i++)
+        {
+          double b = rn2 - ranges[i] * ranges[i] + solver.k[i];
+          x += solver.mx[i] * b;
+          y += solver.my[i] * b;
+        }
+      estimate = Position (beacons[n].first + x, beacons[n].second + y);
+      return true;
+    }
+
+    Localizer::Solver const &
+    Localizer::GetSolver (std::vector<Position> const &beacons)
+    {
+      std::map<std::vector<Position>, Solver>::iterator it = m_cache.find (beacons);
+      if (it != m_cache.end ())
+        {
+          return it->second;
+        }
+      if (m_cache.size () >= m_maxCachedSets)
+        {
+          m_cache.clear ();
+        }
+      Solver &solver = m_cache[beacons];
+      BuildSolver (beacons, solver);
+      return solver;
+    }
+
+    void
+    Localizer::BuildSolver (std::vector<Position> const &beacons, Solver &solver)
+    {
+      //Coordinates relative to the reference beacon keep the squares small
+      size_t n = beacons.size () - 1;
+      double xn = beacons[n].first;
+      double yn = beacons[n].second;
+
+      //Row i of A is 2 (u_i, v_i)
+      double sxx = 0, sxy = 0, syy = 0;
+      for (size_t i = 0; i < n; i++)
+        {
+          double u = beacons[i].first - xn;
+          double v = beacons[i].second - yn;
+          sxx += 4 * u * u;
+          sxy += 4 * u * v;
+          syy += 4 * v * v;
+        }
+
+      double det = sxx * syy - sxy * sxy;
+      solver.valid = det > 1e-12 * sxx * syy;
+      if (!solver.valid)
+        {
+          //Collinear or coincident beacons
+          return;
+        }
+
+      solver.mx.resize (n);
+      solver.my.resize (n);
+      solver.k.resize (n);
+      for (size_t i = 0; i < n; i++)
+        {
+          double u = beacons[i].first - xn;
+          double v = beacons[i].second - yn;
+          solver.mx[i] = (syy * 2 * u - sxy * 2 * v) / det;
+          solver.my[i] = (sxx * 2 * v - sxy * 2 * u) / det;
+          solver.k[i] = u * u + v * v;
+        }
+    }
+
+    bool
+    Localizer::Trilaterate (Position p1, Position p2, Position p3, double r1, double r2, double r3, Position &estimate)
+    {
+      //Unit vector from p1 to p2
+      double dx = p2.first - p1.first;
+      double dy = p2.second - p1.second;
+      double d = std::sqrt (dx * dx + dy * dy);
+      if (d == 0)
+        {
+          return false;
+        }
+      double exx = dx / d;
+      double exy = dy / d;
+
+      //Signed magnitude of the x component of p3
+      double ax = p3.first - p1.first;
+      double ay = p3.second - p1.second;
+      double i = exx * ax + exy * ay;
+
+      //Unit vector in the y direction
+      double aux2x = ax - i * exx;
+      double aux2y = ay - i * exy;
+      double norm = std::sqrt (aux2x * aux2x + aux2y * aux2y);
+      if (norm == 0)
+        {
+          return false;
+        }
+      double eyx = aux2x / norm;
+      double eyy = aux2y / norm;
+
+      //Signed magnitude of the y component of p3
+      double j = eyx * ax + eyy * ay;
+
+      double x = (r1 * r1 - r2 * r2 + d * d) / (2 * d);
+      double y = (r1 * r1 - r3 * r3 + i * i + j * j) / (2 * j) - i * x / j;
+
+      estimate = Position (p1.first + x * exx + y * eyx, p1.second + x * exy + y * eyy);
+      return true;
+    }
+
+
+  }
+}
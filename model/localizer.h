@@ -0,0 +1,110 @@
+#ifndef LOCALIZER_H
+#define LOCALIZER_H
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "distance-table.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+
+    /**
+     * @brief The Localizer class estimates the position of a node by linearized
+     *least-squares multilateration over the beacons of its DistanceTable.
+     *
+     * Subtracting the circle equation of a reference beacon from the others gives
+     * the linear system A p = b, where A only depends on the beacon positions.
+     * The pseudo-inverse (AᵀA)⁻¹Aᵀ is computed once per beacon set and cached,
+     * so nodes that share the same beacons only pay for a matrix-vector product.
+     */
+    class Localizer
+    {
+    public:
+      Localizer();
+
+      /**
+       * @brief SetMaxBeacons Limits the beacons used to the N with the fewest hops
+       * @param maxBeacons The limit, 0 uses every known beacon
+       */
+      void      SetMaxBeacons(uint32_t maxBeacons) { m_maxBeacons = maxBeacons; }
+      uint32_t  GetMaxBeacons() const              { return m_maxBeacons; }
+
+      /**
+       * @brief Localize Estimates a position using hopSize * hops as the distance to each beacon
+       * @param table The distance table of the node
+       * @param hopSize The average distance per hop
+       * @param estimate Set to the estimated position on success
+       * @return False if there are less than 3 beacons or they are collinear
+       */
+      bool Localize(DistanceTable const &table, double hopSize, Position &estimate);
+
+      /**
+       * @brief Localize Estimates a position from explicit beacon positions and distances
+       * @param beacons The beacon positions
+       * @param ranges The estimated distance to each beacon
+       * @param estimate Set to the estimated position on success
+       * @return False if there are less than 3 beacons or they are collinear
+       */
+      bool Localize(std::vector<Position> const &beacons, std::vector<double> const &ranges, Position &estimate);
+
+      /**
+       * @brief GetCacheSize The number of beacon sets whose matrix terms are cached
+       * @return The size
+       */
+      size_t  GetCacheSize() const { return m_cache.size (); }
+      void    ClearCache()         { m_cache.clear (); }
+
+      /**
+       * @brief SetMaxCachedSets Bounds the cache, it is flushed when full. A localizer only used for
+       *one node should keep a single set, the large default pays off when many nodes share beacons
+       * @param maxSets The bound, at least 1
+       */
+      void    SetMaxCachedSets(size_t maxSets) { m_maxCachedSets = std::max<size_t> (maxSets, 1); m_cache.clear (); }
+      size_t  GetMaxCachedSets() const         { return m_maxCachedSets; }
+
+      /**
+       * @brief Trilaterate Closed form position from exactly three beacons, ignoring any other
+       * @return False if the beacons are coincident or collinear
+       */
+      static bool Trilaterate(Position p1, Position p2, Position p3, double r1, double r2, double r3, Position &estimate);
+
+      //Beacon-dependent terms of the least-squares solution, relative to the last beacon
+      struct Solver
+      {
+        bool                valid;
+        //Rows of (AᵀA)⁻¹Aᵀ, one column per non-reference beacon
+        std::vector<double> mx;
+        std::vector<double> my;
+        //Squared distance of each non-reference beacon to the reference
+        std::vector<double> k;
+      };
+
+      /**
+       * @brief BuildSolver Computes the beacon-dependent terms, shared with BatchLocalizer
+       * @param beacons The beacon positions, the last one is the reference
+       * @param solver Filled with the terms, valid is false for collinear beacons
+       */
+      static void     BuildSolver(std::vector<Position> const &beacons, Solver &solver);
+
+    private:
+      Solver const &  GetSolver(std::vector<Position> const &beacons);
+
+      uint32_t  m_maxBeacons;
+      size_t    m_maxCachedSets;
+      std::map<std::vector<Position>, Solver> m_cache;
+
+      //Scratch buffers reused across calls
+      std::vector<DistanceTable::Entry const *> m_selected;
+      std::vector<Position> m_positions;
+      std::vector<double>   m_ranges;
+    };
+
+
+  }
+}
+
+#endif // LOCALIZER_H
@@ -0,0 +1,33 @@
+#include "location-registry.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+
+    LocationRegistry::LocationRegistry()
+    {
+    }
+
+    void
+    LocationRegistry::SetPosition (Ipv4Address address, Position position)
+    {
+      m_positions[address] = position;
+    }
+
+    bool
+    LocationRegistry::GetPosition (Ipv4Address address, Position &position) const
+    {
+      std::map<Ipv4Address, Position>::const_iterator it = m_positions.find (address);
+      if (it == m_positions.end ())
+        {
+          return false;
+        }
+      position = it->second;
+      return true;
+    }
+
+
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef LOCATIONREGISTRY_H
+#define LOCATIONREGISTRY_H
+
+#include <map>
+#include "ns3/ipv4-address.h"
+#include "ns3/simple-ref-count.h"
+#include "distance-table.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+
+    /**
+     * @brief The LocationRegistry class maps node addresses to the position used
+     *as destination by geographic forwarding.
+     *
+     * It stands in for a location service: every RoutingProtocol sharing the
+     * registry publishes its beacon position or its DV-Hop estimate, and looks
+     * up the position of the destinations it forwards to.
+     */
+    class LocationRegistry : public SimpleRefCount<LocationRegistry>
+    {
+    public:
+      LocationRegistry();
+
+      /**
+       * @brief SetPosition Publishes the position of an address, replacing the previous one
+       * @param address The node address
+       * @param position Its position
+       */
+      void SetPosition(Ipv4Address address, Position position);
+
+      /**
+       * @brief GetPosition Looks up the position of an address
+       * @param address The node address
+       * @param position Set to its position
+       * @return False if nothing was published for the address
+       */
+      bool GetPosition(Ipv4Address address, Position &position) const;
+
+      void   Remove(Ipv4Address address) { m_positions.erase (address); }
+      size_t GetSize() const              { return m_positions.size (); }
+
+    private:
+      std::map<Ipv4Address, Position> m_positions;
+    };
+
+
+  }
+}
+
+#endif // LOCATIONREGISTRY_H
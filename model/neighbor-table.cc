@@ -0,0 +1,101 @@
+#include "neighbor-table.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+    namespace
+    {
+      struct AddressBefore
+      {
+        bool operator() (NeighborTable::Neighbor const &n, Ipv4Address address) const
+        {
+          return n.address.Get () < address.Get ();
+        }
+      };
+
+      struct HeardBefore
+      {
+        explicit HeardBefore (Time cutoff) : m_cutoff (cutoff) {}
+        bool operator() (NeighborTable::Neighbor const &n) const
+        {
+          return n.heardAt <= m_cutoff;
+        }
+        Time m_cutoff;
+      };
+
+      double
+      SquaredDistance (Position a, Position b)
+      {
+        double dx = a.first - b.first;
+        double dy = a.second - b.second;
+        return dx * dx + dy * dy;
+      }
+    }
+
+
+    NeighborTable::NeighborTable()
+    {
+    }
+
+    void
+    NeighborTable::Update (Ipv4Address neighbor, Position position, uint32_t interface)
+    {
+      std::vector<Neighbor>::iterator it = std::lower_bound (m_neighbors.begin (), m_neighbors.end (), neighbor, AddressBefore ());
+      if (it == m_neighbors.end () || it->address != neighbor)
+        {
+          Neighbor n;
+          n.address = neighbor;
+          it = m_neighbors.insert (it, n);
+        }
+      it->position = position;
+      it->interface = interface;
+      it->heardAt = Simulator::Now ();
+    }
+
+    NeighborTable::Neighbor const *
+    NeighborTable::Find (Ipv4Address neighbor) const
+    {
+      std::vector<Neighbor>::const_iterator it = std::lower_bound (m_neighbors.begin (), m_neighbors.end (), neighbor, AddressBefore ());
+      if (it != m_neighbors.end () && it->address == neighbor)
+        {
+          return &*it;
+        }
+      return 0;
+    }
+
+    NeighborTable::Neighbor const *
+    NeighborTable::GetClosestTo (Position target, Position self, Time cutoff) const
+    {
+      Neighbor const *best = 0;
+      double bestDistance = SquaredDistance (self, target);
+      for (std::vector<Neighbor>::const_iterator it = m_neighbors.begin (); it != m_neighbors.end (); ++it)
+        {
+          if (it->heardAt <= cutoff)
+            {
+              continue;
+            }
+          double distance = SquaredDistance (it->position, target);
+          if (distance < bestDistance)
+            {
+              best = &*it;
+              bestDistance = distance;
+            }
+        }
+      return best;
+    }
+
+    uint32_t
+    NeighborTable::Purge (Time cutoff)
+    {
+      size_t before = m_neighbors.size ();
+      m_neighbors.erase (std::remove_if (m_neighbors.begin (), m_neighbors.end (), HeardBefore (cutoff)), m_neighbors.end ());
+      return before - m_neighbors.size ();
+    }
+
+
+  }
+}
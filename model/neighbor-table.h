@@ -0,0 +1,76 @@
+#ifndef NEIGHBORTABLE_H
+#define NEIGHBORTABLE_H
+
+#include <vector>
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include "distance-table.h"
+
+namespace ns3
+{
+  namespace dvhop
+  {
+
+
+    /**
+     * @brief The NeighborTable class stores the last position advertised by each
+     *one hop neighbor, for greedy geographic forwarding.
+     *
+     * Its size only depends on the node degree, not on the number of destinations.
+     * Entries are kept in a contiguous vector sorted by address, like the DistanceTable.
+     */
+    class NeighborTable
+    {
+    public:
+      struct Neighbor
+      {
+        Ipv4Address address;
+        Position    position;
+        uint32_t    interface;
+        Time        heardAt;
+      };
+
+      NeighborTable();
+
+      /**
+       * @brief Update Stores the position advertised by a neighbor on a HELLO
+       * @param neighbor The neighbor address
+       * @param position The position it advertised
+       * @param interface The interface the HELLO was received on
+       */
+      void Update(Ipv4Address neighbor, Position position, uint32_t interface);
+
+      /**
+       * @brief Find Looks up a neighbor
+       * @param neighbor The neighbor address
+       * @return The neighbor, or 0 if it is unknown
+       */
+      Neighbor const * Find(Ipv4Address neighbor) const;
+
+      /**
+       * @brief GetClosestTo Greedy next hop selection
+       * @param target The position of the destination
+       * @param self The position of this node, the chosen neighbor must be closer to the target
+       * @param cutoff Neighbors last heard at this time or before are ignored
+       * @return The neighbor closest to the target, or 0 at a dead end
+       */
+      Neighbor const * GetClosestTo(Position target, Position self, Time cutoff) const;
+
+      /**
+       * @brief Purge Removes the neighbors not heard since a given time
+       * @param cutoff Neighbors heard at this time or before are removed
+       * @return The number of removed neighbors
+       */
+      uint32_t Purge(Time cutoff);
+
+      size_t  GetSize() const  { return m_neighbors.size (); }
+
+    private:
+      std::vector<Neighbor>  m_neighbors;
+    };
+
+
+  }
+}
+
+#endif // NEIGHBORTABLE_H
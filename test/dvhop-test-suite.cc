@@ -2,9 +2,29 @@
 
 // Include a header file from your module to test.
 #include "ns3/dvhop.h"
+#include "ns3/dvhop-packet.h"
+#include "ns3/distance-table.h"
+#include "ns3/neighbor-table.h"
+#include "ns3/distance-snapshot.h"
+#include "ns3/localizer.h"
+#include "ns3/batch-localizer.h"
+#include "ns3/dvhop-helper.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/simple-channel.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-address-generator.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
+#include <cmath>
+#include <cstring>
 
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
@@ -46,6 +66,1342 @@ DvhopTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Checks that a HELLO carrying several beacons survives a trip through a Packet
+class HelloHeaderTestCase : public TestCase
+{
+public:
+  HelloHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+HelloHeaderTestCase::HelloHeaderTestCase ()
+  : TestCase ("HelloHeader serializes and deserializes every entry")
+{
+}
+
+void
+HelloHeaderTestCase::DoRun (void)
+{
+  dvhop::HelloHeader hello;
+  for (uint16_t i = 0; i < 5; ++i)
+    {
+      hello.AddEntry (dvhop::FloodingHeader (10.5 * i, 20.25 * i, i, i + 1, Ipv4Address (0x0a000001 + i)));
+    }
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSerializedSize (), 4 + 5 * 24, "Unexpected HELLO size");
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (hello);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), hello.GetSerializedSize (), "Packet size does not match the header");
+
+  dvhop::HelloHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntryCount (), 5, "Entries were lost");
+  for (uint16_t i = 0; i < 5; ++i)
+    {
+      dvhop::FloodingHeader const &entry = received.GetEntries ()[i];
+      NS_TEST_ASSERT_MSG_EQ (entry.GetBeaconAddress (), Ipv4Address (0x0a000001 + i), "Wrong beacon address");
+      NS_TEST_ASSERT_MSG_EQ (entry.GetHopCount (), i + 1, "Wrong hop count");
+      NS_TEST_ASSERT_MSG_EQ (entry.GetSequenceNumber (), i, "Wrong sequence number");
+      NS_TEST_ASSERT_MSG_EQ_TOL (entry.GetXPosition (), 10.5 * i, 1e-9, "Wrong X position");
+      NS_TEST_ASSERT_MSG_EQ_TOL (entry.GetYPosition (), 20.25 * i, 1e-9, "Wrong Y position");
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (hello.GetMaxEntries (1472), 61, "Wrong number of entries for a 1500 bytes MTU");
+
+  // A serialized HELLO resent with a newer sequence number patched in
+  std::vector<uint32_t> offsets;
+  bool networkOrder;
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSequenceNumberOffsets (offsets, networkOrder), true, "Plain entries can be patched");
+  NS_TEST_ASSERT_MSG_EQ (offsets.size (), 5, "One offset per entry");
+  std::vector<uint8_t> bytes (hello.GetSerializedSize ());
+  packet = Create<Packet> ();
+  packet->AddHeader (hello);
+  packet->CopyData (&bytes[0], bytes.size ());
+  dvhop::HelloHeader::WriteSequenceNumber (&bytes[0], offsets[3], 300, networkOrder);
+  Ptr<Packet> patched = Create<Packet> (&bytes[0], bytes.size ());
+  patched->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntries ()[3].GetSequenceNumber (), 300, "Sequence number was not patched");
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntries ()[3].GetHopCount (), 4, "Patching must not touch the hop count");
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntries ()[2].GetSequenceNumber (), 2, "Only the patched entry must change");
+}
+
+// Checks the compact encoding: quantized positions and varint hops and sequence numbers
+class CompactHelloHeaderTestCase : public TestCase
+{
+public:
+  CompactHelloHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+CompactHelloHeaderTestCase::CompactHelloHeaderTestCase ()
+  : TestCase ("Compact HelloHeader keeps positions within the resolution")
+{
+}
+
+void
+CompactHelloHeaderTestCase::DoRun (void)
+{
+  dvhop::HelloHeader hello;
+  hello.SetCompact (true, 0.01);
+  hello.AddEntry (dvhop::FloodingHeader (12.345, -7.891, 100, 1, Ipv4Address ("10.0.0.1")));
+  hello.AddEntry (dvhop::FloodingHeader (5000.0, 0.004, 101, 200, Ipv4Address ("10.0.0.2")));
+  hello.AddEntry (dvhop::FloodingHeader (0.0, 99.99, 65535, 2, Ipv4Address ("10.0.0.3")));
+  // 8 bytes header, 12 fixed bytes per entry plus the varints: (1 + 2), (2 + 1) and (1 + 3)
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSerializedSize (), 8 + 15 + 15 + 16, "Unexpected compact HELLO size");
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (hello);
+
+  dvhop::HelloHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.IsCompact (), true, "Compact flag was lost");
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntryCount (), 3, "Entries were lost");
+  for (uint16_t i = 0; i < 3; ++i)
+    {
+      dvhop::FloodingHeader const &sent = hello.GetEntries ()[i];
+      dvhop::FloodingHeader const &entry = received.GetEntries ()[i];
+      NS_TEST_ASSERT_MSG_EQ (entry.GetBeaconAddress (), sent.GetBeaconAddress (), "Wrong beacon address");
+      NS_TEST_ASSERT_MSG_EQ (entry.GetHopCount (), sent.GetHopCount (), "Wrong hop count");
+      NS_TEST_ASSERT_MSG_EQ (entry.GetSequenceNumber (), sent.GetSequenceNumber (), "Wrong sequence number");
+      NS_TEST_ASSERT_MSG_EQ_TOL (entry.GetXPosition (), sent.GetXPosition (), 0.005, "X position out of resolution");
+      NS_TEST_ASSERT_MSG_EQ_TOL (entry.GetYPosition (), sent.GetYPosition (), 0.005, "Y position out of resolution");
+    }
+}
+
+// Checks that interned entries only carry a position when flagged
+class InternedHelloHeaderTestCase : public TestCase
+{
+public:
+  InternedHelloHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+InternedHelloHeaderTestCase::InternedHelloHeaderTestCase ()
+  : TestCase ("Interned HelloHeader omits known positions")
+{
+}
+
+void
+InternedHelloHeaderTestCase::DoRun (void)
+{
+  dvhop::HelloHeader hello;
+  hello.SetInterned (true);
+  hello.SetPositionRequest (true);
+  dvhop::FloodingHeader withPos (1.5, 2.5, 7, 3, Ipv4Address ("10.0.0.1"));
+  withPos.SetPositionVersion (5);
+  dvhop::FloodingHeader withoutPos (0, 0, 8, 4, Ipv4Address ("10.0.0.2"));
+  withoutPos.SetPositionVersion (2);
+  withoutPos.SetHasPosition (false);
+  hello.AddEntry (withPos);
+  hello.AddEntry (withoutPos);
+  // 4 bytes header, 9 bytes per entry plus 16 bytes for the only position
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSerializedSize (), 4 + 9 + 16 + 9, "Unexpected interned HELLO size");
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (hello);
+
+  dvhop::HelloHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.IsInterned (), true, "Interned flag was lost");
+  NS_TEST_ASSERT_MSG_EQ (received.IsPositionRequest (), true, "Position request was lost");
+  dvhop::FloodingHeader const &first = received.GetEntries ()[0];
+  dvhop::FloodingHeader const &second = received.GetEntries ()[1];
+  NS_TEST_ASSERT_MSG_EQ (first.HasPosition (), true, "Position was lost");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t) first.GetPositionVersion (), 5, "Wrong position version");
+  NS_TEST_ASSERT_MSG_EQ_TOL (first.GetYPosition (), 2.5, 1e-9, "Wrong Y position");
+  NS_TEST_ASSERT_MSG_EQ (second.HasPosition (), false, "Unexpected position");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t) second.GetPositionVersion (), 2, "Wrong position version");
+  NS_TEST_ASSERT_MSG_EQ (second.GetHopCount (), 4, "Wrong hop count");
+
+  // The entries following a position are patched at the right offset
+  std::vector<uint32_t> offsets;
+  bool networkOrder;
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSequenceNumberOffsets (offsets, networkOrder), true, "Interned entries can be patched");
+  std::vector<uint8_t> bytes (hello.GetSerializedSize ());
+  packet = Create<Packet> ();
+  packet->AddHeader (hello);
+  packet->CopyData (&bytes[0], bytes.size ());
+  dvhop::HelloHeader::WriteSequenceNumber (&bytes[0], offsets[1], 513, networkOrder);
+  Ptr<Packet> patched = Create<Packet> (&bytes[0], bytes.size ());
+  patched->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntries ()[1].GetSequenceNumber (), 513, "Sequence number was not patched");
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntries ()[1].GetHopCount (), 4, "Patching must not touch the hop count");
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntries ()[0].GetSequenceNumber (), 7, "Only the patched entry must change");
+
+  hello.SetCompact (true);
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSequenceNumberOffsets (offsets, networkOrder), false, "Varint deltas can not be patched");
+}
+
+// Checks that the beacon hop size survives serialization
+class HopSizeHelloHeaderTestCase : public TestCase
+{
+public:
+  HopSizeHelloHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+HopSizeHelloHeaderTestCase::HopSizeHelloHeaderTestCase ()
+  : TestCase ("HelloHeader carries the beacon hop size and the sender position")
+{
+}
+
+void
+HopSizeHelloHeaderTestCase::DoRun (void)
+{
+  dvhop::HelloHeader hello;
+  hello.SetHopSize (Ipv4Address ("10.0.0.3"), 87.5, 2, 9);
+  // 4 bytes header, 12 bytes hop size and no entries
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSerializedSize (), 4 + 12, "Unexpected hop size HELLO size");
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (hello);
+
+  dvhop::HelloHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.HasHopSize (), true, "Hop size was lost");
+  NS_TEST_ASSERT_MSG_EQ (received.GetHopSizeBeacon (), Ipv4Address ("10.0.0.3"), "Wrong hop size beacon");
+  NS_TEST_ASSERT_MSG_EQ_TOL (received.GetHopSize (), 87.5, 1e-3, "Wrong hop size");
+  NS_TEST_ASSERT_MSG_EQ (received.GetHopSizeHops (), 2, "Wrong hop size distance");
+  NS_TEST_ASSERT_MSG_EQ (received.GetHopSizeSeqNo (), 9, "Wrong hop size sequence number");
+  NS_TEST_ASSERT_MSG_EQ (received.GetEntryCount (), 0, "Unexpected entries");
+  NS_TEST_ASSERT_MSG_EQ (received.HasSenderPosition (), false, "Unexpected sender position");
+
+  // 8 more bytes for the sender position
+  hello.SetSenderPosition (120.5, -3.25);
+  NS_TEST_ASSERT_MSG_EQ (hello.GetSerializedSize (), 4 + 12 + 8, "Unexpected sender position HELLO size");
+  packet = Create<Packet> ();
+  packet->AddHeader (hello);
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.HasSenderPosition (), true, "Sender position was lost");
+  NS_TEST_ASSERT_MSG_EQ_TOL (received.GetSenderX (), 120.5, 1e-3, "Wrong sender X");
+  NS_TEST_ASSERT_MSG_EQ_TOL (received.GetSenderY (), -3.25, 1e-3, "Wrong sender Y");
+  NS_TEST_ASSERT_MSG_EQ (received.GetHopSizeSeqNo (), 9, "The hop size must still follow the header");
+}
+
+// Checks that only changed entries are reported for delta HELLOs
+class DistanceTableDirtyTestCase : public TestCase
+{
+public:
+  DistanceTableDirtyTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DistanceTableDirtyTestCase::DistanceTableDirtyTestCase ()
+  : TestCase ("DistanceTable tracks the entries changed since the last HELLO")
+{
+}
+
+void
+DistanceTableDirtyTestCase::DoRun (void)
+{
+  dvhop::DistanceTable table;
+  Ipv4Address b1 ("10.0.0.1");
+  Ipv4Address b2 ("10.0.0.2");
+
+  table.AddBeacon (b1, 3, 1.0, 2.0);
+  table.AddBeacon (b2, 5, 3.0, 4.0);
+  NS_TEST_ASSERT_MSG_EQ (table.GetChangedBeacons ().size (), 2, "New entries must be advertised");
+
+  table.ClearDirty ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetChangedBeacons ().size (), 0, "Nothing changed since the last HELLO");
+
+  uint32_t version = table.GetVersion ();
+  table.AddBeacon (b1, 3, 1.0, 2.0);
+  NS_TEST_ASSERT_MSG_EQ (table.IsDirty (b1), false, "Same information must not be advertised again");
+  table.ClearDirty ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetVersion (), version, "A refresh must let the previous HELLOs be reused");
+
+  // The beacons bump their sequence number every full round, the refresh is advertised but patched in
+  uint32_t dirtyVersion = table.GetDirtyVersion ();
+  table.AddBeacon (b1, 3, 1.0, 2.0, 1);
+  NS_TEST_ASSERT_MSG_EQ (table.IsDirty (b1), true, "A newer sequence number must be advertised");
+  NS_TEST_ASSERT_MSG_NE (table.GetDirtyVersion (), dirtyVersion, "Delta HELLOs must see the refresh");
+  table.ClearDirty ();
+  NS_TEST_ASSERT_MSG_EQ (table.GetVersion (), version, "A newer sequence number must let the previous HELLOs be reused");
+
+  table.AddBeacon (b2, 4, 3.0, 4.0);
+  NS_TEST_ASSERT_MSG_EQ (table.IsDirty (b2), true, "A shorter path must be advertised");
+  NS_TEST_ASSERT_MSG_EQ (table.GetChangedBeacons ().size (), 1, "Only the changed entry must be advertised");
+  NS_TEST_ASSERT_MSG_NE (table.GetVersion (), version, "A change must invalidate the previous HELLOs");
+}
+
+// Checks lookups and the address order of the flat table
+class DistanceTableLookupTestCase : public TestCase
+{
+public:
+  DistanceTableLookupTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DistanceTableLookupTestCase::DistanceTableLookupTestCase ()
+  : TestCase ("DistanceTable finds entries and iterates in address order")
+{
+}
+
+void
+DistanceTableLookupTestCase::DoRun (void)
+{
+  dvhop::DistanceTable table;
+  table.AddBeacon (Ipv4Address ("10.0.0.9"), 2, 9.0, 9.0);
+  table.AddBeacon (Ipv4Address ("10.0.0.1"), 4, 1.0, 1.0);
+  table.AddBeacon (Ipv4Address ("10.0.0.5"), 1, 5.0, 5.0);
+  table.AddBeacon (Ipv4Address ("10.0.0.1"), 3, 1.0, 1.0);
+
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 3, "Updating an entry must not insert a new one");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (Ipv4Address ("10.0.0.1")), 3, "Wrong hops after the update");
+  NS_TEST_ASSERT_MSG_EQ (table.GetHopsTo (Ipv4Address ("10.0.0.7")), 0, "Unknown beacons have 0 hops");
+  NS_TEST_ASSERT_MSG_EQ ((table.Find (Ipv4Address ("10.0.0.7")) == 0), true, "Unknown beacons must not be found");
+  NS_TEST_ASSERT_MSG_EQ_TOL (table.GetBeaconPosition (Ipv4Address ("10.0.0.5")).first, 5.0, 1e-9, "Wrong position");
+
+  // The next hop follows the neighbor of the latest accepted update, without dirtying the entry
+  table.ClearDirty ();
+  table.AddBeacon (Ipv4Address ("10.0.0.5"), 1, 5.0, 5.0, 0, 0, Ipv4Address ("10.0.0.20"), 1);
+  Ipv4Address nextHop;
+  uint32_t interface = 0;
+  NS_TEST_ASSERT_MSG_EQ (table.GetNextHop (Ipv4Address ("10.0.0.5"), nextHop, interface), true, "Known beacons have a next hop");
+  NS_TEST_ASSERT_MSG_EQ (nextHop, Ipv4Address ("10.0.0.20"), "Wrong next hop");
+  NS_TEST_ASSERT_MSG_EQ (interface, 1, "Wrong interface");
+  NS_TEST_ASSERT_MSG_EQ (table.IsDirty (Ipv4Address ("10.0.0.5")), false, "The next hop is not advertised");
+  NS_TEST_ASSERT_MSG_EQ (table.GetNextHop (Ipv4Address ("10.0.0.7"), nextHop, interface), false, "Unknown beacons have no next hop");
+
+  std::vector<Ipv4Address> beacons = table.GetKnownBeacons ();
+  NS_TEST_ASSERT_MSG_EQ (beacons[0], Ipv4Address ("10.0.0.1"), "Entries must be sorted by address");
+  NS_TEST_ASSERT_MSG_EQ (beacons[1], Ipv4Address ("10.0.0.5"), "Entries must be sorted by address");
+  NS_TEST_ASSERT_MSG_EQ (beacons[2], Ipv4Address ("10.0.0.9"), "Entries must be sorted by address");
+
+  // Every entry was updated now
+  NS_TEST_ASSERT_MSG_EQ (table.Purge (Simulator::Now () - Seconds (1)), 0, "Fresh entries must not be purged");
+  std::vector<dvhop::DistanceTable::Entry> expired;
+  NS_TEST_ASSERT_MSG_EQ (table.Purge (Simulator::Now (), &expired), 3, "Expired entries must be purged");
+  NS_TEST_ASSERT_MSG_EQ (expired.size (), 3, "Every purged entry must be reported");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 0, "The table must be empty");
+}
+
+// Checks that a binary snapshot reads back the tables it was written from
+class DistanceSnapshotTestCase : public TestCase
+{
+public:
+  DistanceSnapshotTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+DistanceSnapshotTestCase::DistanceSnapshotTestCase ()
+  : TestCase ("Distance table snapshots are read back through mmap")
+{
+}
+
+void
+DistanceSnapshotTestCase::DoRun (void)
+{
+  dvhop::DistanceTable first;
+  first.AddBeacon (Ipv4Address ("10.0.0.9"), 2, 9.0, -9.0, 4, 0, Ipv4Address ("10.0.0.3"), 1);
+  first.AddBeacon (Ipv4Address ("10.0.0.1"), 5, 1.0, 1.0, 7);
+  dvhop::DistanceTable empty;
+  dvhop::DistanceTable last;
+  last.AddBeacon (Ipv4Address ("10.0.0.1"), 1, 1.0, 1.0);
+
+  std::string filename = CreateTempDirFilename ("dvhop.snapshot");
+  dvhop::SnapshotNode state;
+  std::memset (&state, 0, sizeof (state));
+  state.node = 0;
+  state.flags = dvhop::SnapshotNode::HAS_HOP_SIZE;
+  state.hopSize = 12.5;
+  state.hopSizeBeacon = Ipv4Address ("10.0.0.9").Get ();
+
+  dvhop::SnapshotWriter writer;
+  NS_TEST_ASSERT_MSG_EQ (writer.Open (filename, Seconds (12)), true, "Could not create the snapshot");
+  writer.SetTopology (0xabcd);
+  writer.AddTable (state, first);
+  writer.AddTable (3, empty);
+  writer.AddTable (7, last);
+  NS_TEST_ASSERT_MSG_EQ (writer.Close (), true, "Could not write the snapshot");
+
+  dvhop::SnapshotReader reader;
+  NS_TEST_ASSERT_MSG_EQ (reader.Open (filename), true, "Could not map the snapshot");
+  NS_TEST_ASSERT_MSG_EQ (reader.GetHeader ().nodes, 3, "Wrong node count");
+  NS_TEST_ASSERT_MSG_EQ (reader.GetRecordCount (), 3, "Wrong record count");
+  NS_TEST_ASSERT_MSG_EQ (reader.GetHeader ().time, Seconds (12).GetNanoSeconds (), "Wrong snapshot time");
+  NS_TEST_ASSERT_MSG_EQ (reader.GetHeader ().topology, 0xabcd, "Wrong topology hash");
+
+  dvhop::SnapshotNode const *saved = reader.FindNodeState (0);
+  NS_TEST_ASSERT_MSG_EQ ((saved != 0), true, "Node 0 state missing");
+  NS_TEST_ASSERT_MSG_EQ ((saved->flags & dvhop::SnapshotNode::HAS_HOP_SIZE) != 0, true, "Hop size flag lost");
+  NS_TEST_ASSERT_MSG_EQ_TOL (saved->hopSize, 12.5, 1e-9, "Wrong hop size");
+  NS_TEST_ASSERT_MSG_EQ ((reader.FindNodeState (7) != 0), true, "Node 7 state missing");
+  NS_TEST_ASSERT_MSG_EQ ((reader.FindNodeState (5) == 0), true, "Node 5 is not in the snapshot");
+
+  dvhop::SnapshotRecord const *begin;
+  dvhop::SnapshotRecord const *end;
+  reader.FindNode (0, begin, end);
+  NS_TEST_ASSERT_MSG_EQ (end - begin, 2, "Wrong table size for node 0");
+  NS_TEST_ASSERT_MSG_EQ (Ipv4Address (begin[0].beacon), Ipv4Address ("10.0.0.1"), "Records must follow the address order");
+  NS_TEST_ASSERT_MSG_EQ (begin[0].seqNo, 7, "Wrong sequence number");
+  NS_TEST_ASSERT_MSG_EQ (begin[1].hops, 2, "Wrong hops");
+  NS_TEST_ASSERT_MSG_EQ (Ipv4Address (begin[1].nextHop), Ipv4Address ("10.0.0.3"), "Wrong next hop");
+  NS_TEST_ASSERT_MSG_EQ (begin[1].interface, 1, "Wrong interface");
+  NS_TEST_ASSERT_MSG_EQ_TOL (begin[1].y, -9.0, 1e-9, "Wrong position");
+  reader.FindNode (3, begin, end);
+  NS_TEST_ASSERT_MSG_EQ ((begin == end), true, "Node 3 has an empty table");
+  reader.FindNode (7, begin, end);
+  NS_TEST_ASSERT_MSG_EQ (end - begin, 1, "Wrong table size for node 7");
+}
+
+// Checks the greedy next hop selection of geographic forwarding
+class NeighborTableTestCase : public TestCase
+{
+public:
+  NeighborTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+NeighborTableTestCase::NeighborTableTestCase ()
+  : TestCase ("NeighborTable picks the neighbor closest to the target")
+{
+}
+
+void
+NeighborTableTestCase::DoRun (void)
+{
+  dvhop::NeighborTable neighbors;
+  neighbors.Update (Ipv4Address ("10.0.0.2"), dvhop::Position (10.0, 0.0), 1);
+  neighbors.Update (Ipv4Address ("10.0.0.3"), dvhop::Position (0.0, 10.0), 1);
+  neighbors.Update (Ipv4Address ("10.0.0.2"), dvhop::Position (20.0, 0.0), 2);
+  NS_TEST_ASSERT_MSG_EQ (neighbors.GetSize (), 2, "Updating a neighbor must not insert a new one");
+
+  dvhop::Position self (0.0, 0.0);
+  Time cutoff = Simulator::Now () - Seconds (1);
+  dvhop::NeighborTable::Neighbor const *next = neighbors.GetClosestTo (dvhop::Position (100.0, 0.0), self, cutoff);
+  NS_TEST_ASSERT_MSG_EQ ((next != 0), true, "A neighbor is closer to the target");
+  NS_TEST_ASSERT_MSG_EQ (next->address, Ipv4Address ("10.0.0.2"), "Wrong greedy next hop");
+  NS_TEST_ASSERT_MSG_EQ (next->interface, 2, "The latest HELLO must give the interface");
+
+  next = neighbors.GetClosestTo (dvhop::Position (-100.0, -100.0), self, cutoff);
+  NS_TEST_ASSERT_MSG_EQ ((next == 0), true, "No neighbor is closer than this node, dead end");
+
+  next = neighbors.GetClosestTo (dvhop::Position (100.0, 0.0), self, Simulator::Now ());
+  NS_TEST_ASSERT_MSG_EQ ((next == 0), true, "Expired neighbors must be ignored");
+  NS_TEST_ASSERT_MSG_EQ (neighbors.Purge (Simulator::Now ()), 2, "Expired neighbors must be purged");
+}
+
+// Checks the least-squares localization against exact distances
+class LocalizerTestCase : public TestCase
+{
+public:
+  LocalizerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LocalizerTestCase::LocalizerTestCase ()
+  : TestCase ("Localizer solves multilateration over all beacons")
+{
+}
+
+void
+LocalizerTestCase::DoRun (void)
+{
+  std::vector<dvhop::Position> beacons;
+  beacons.push_back (dvhop::Position (0, 0));
+  beacons.push_back (dvhop::Position (100, 0));
+  beacons.push_back (dvhop::Position (0, 100));
+  beacons.push_back (dvhop::Position (100, 100));
+  dvhop::Position node (30, 40);
+  std::vector<double> ranges;
+  for (size_t i = 0; i < beacons.size (); i++)
+    {
+      double dx = beacons[i].first - node.first;
+      double dy = beacons[i].second - node.second;
+      ranges.push_back (std::sqrt (dx * dx + dy * dy));
+    }
+
+  dvhop::Localizer localizer;
+  dvhop::Position estimate;
+  NS_TEST_ASSERT_MSG_EQ (localizer.Localize (beacons, ranges, estimate), true, "Localization failed");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimate.first, 30, 1e-6, "Wrong X estimate");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimate.second, 40, 1e-6, "Wrong Y estimate");
+  NS_TEST_ASSERT_MSG_EQ (localizer.Localize (beacons, ranges, estimate), true, "Localization failed");
+  NS_TEST_ASSERT_MSG_EQ (localizer.GetCacheSize (), 1, "The beacon set must be reused");
+
+  // A single set cache, as kept by each node
+  dvhop::Localizer single;
+  single.SetMaxCachedSets (1);
+  std::vector<dvhop::Position> moved (beacons);
+  moved[0].first += 1;
+  NS_TEST_ASSERT_MSG_EQ (single.Localize (beacons, ranges, estimate), true, "Localization failed");
+  NS_TEST_ASSERT_MSG_EQ (single.Localize (moved, ranges, estimate), true, "Localization failed");
+  NS_TEST_ASSERT_MSG_EQ (single.GetCacheSize (), 1, "Only the last beacon set must be kept");
+
+  NS_TEST_ASSERT_MSG_EQ (dvhop::Localizer::Trilaterate (beacons[0], beacons[1], beacons[2], ranges[0], ranges[1], ranges[2], estimate),
+                         true, "Trilateration failed");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimate.first, 30, 1e-6, "Wrong X trilateration");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimate.second, 40, 1e-6, "Wrong Y trilateration");
+
+  std::vector<dvhop::Position> collinear;
+  collinear.push_back (dvhop::Position (0, 0));
+  collinear.push_back (dvhop::Position (50, 50));
+  collinear.push_back (dvhop::Position (100, 100));
+  NS_TEST_ASSERT_MSG_EQ (localizer.Localize (collinear, std::vector<double> (3, 10), estimate), false, "Collinear beacons must fail");
+
+  // Best N: the beacon 5 hops away is left out
+  dvhop::DistanceTable table;
+  table.AddBeacon (Ipv4Address ("10.0.0.1"), 1, 0, 0);
+  table.AddBeacon (Ipv4Address ("10.0.0.2"), 1, 10, 0);
+  table.AddBeacon (Ipv4Address ("10.0.0.3"), 1, 0, 10);
+  table.AddBeacon (Ipv4Address ("10.0.0.4"), 5, 500, 500);
+  localizer.SetMaxBeacons (3);
+  NS_TEST_ASSERT_MSG_EQ (localizer.Localize (table, 5, estimate), true, "Localization failed");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimate.first, 5, 1e-6, "Far beacon was used");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimate.second, 5, 1e-6, "Far beacon was used");
+}
+
+// Checks that every batch kernel matches the per-node Localizer
+class BatchLocalizerTestCase : public TestCase
+{
+public:
+  BatchLocalizerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BatchLocalizerTestCase::BatchLocalizerTestCase ()
+  : TestCase ("BatchLocalizer kernels agree with the Localizer")
+{
+}
+
+void
+BatchLocalizerTestCase::DoRun (void)
+{
+  const uint32_t beacons = 5;
+  // Not a multiple of the vector width, so the scalar tail runs too
+  const uint32_t nodes = 7;
+  std::vector<double> bx, by;
+  std::vector<dvhop::Position> positions;
+  for (uint32_t j = 0; j < beacons; j++)
+    {
+      bx.push_back (100.0 * j);
+      by.push_back (37.0 * j * j);
+      positions.push_back (dvhop::Position (bx[j], by[j]));
+    }
+  std::vector<uint16_t> hops (beacons * nodes);
+  std::vector<double> hopSizes (nodes);
+  for (uint32_t i = 0; i < nodes; i++)
+    {
+      hopSizes[i] = 40 + i;
+      for (uint32_t j = 0; j < beacons; j++)
+        {
+          hops[j * nodes + i] = 1 + (i + 2 * j) % 6;
+        }
+    }
+
+  dvhop::BatchLocalizer batch;
+  NS_TEST_ASSERT_MSG_EQ (batch.SetBeacons (bx, by), true, "Beacons must be usable");
+
+  dvhop::Localizer localizer;
+  dvhop::BatchLocalizer::Kernel kernels[] = { dvhop::BatchLocalizer::SCALAR, dvhop::BatchLocalizer::SSE2, dvhop::BatchLocalizer::AVX2 };
+  for (uint32_t k = 0; k < 3; k++)
+    {
+      if (!dvhop::BatchLocalizer::IsSupported (kernels[k]))
+        {
+          continue;
+        }
+      batch.SetKernel (kernels[k]);
+      std::vector<double> x (nodes), y (nodes);
+      NS_TEST_ASSERT_MSG_EQ (batch.Localize (nodes, &hops[0], &hopSizes[0], &x[0], &y[0]), true, "Batch localization failed");
+      for (uint32_t i = 0; i < nodes; i++)
+        {
+          std::vector<double> ranges;
+          for (uint32_t j = 0; j < beacons; j++)
+            {
+              ranges.push_back (hopSizes[i] * hops[j * nodes + i]);
+            }
+          dvhop::Position estimate;
+          localizer.Localize (positions, ranges, estimate);
+          NS_TEST_ASSERT_MSG_EQ_TOL (x[i], estimate.first, 1e-6, "Kernel " << k << " disagrees on X");
+          NS_TEST_ASSERT_MSG_EQ_TOL (y[i], estimate.second, 1e-6, "Kernel " << k << " disagrees on Y");
+        }
+    }
+}
+
+// Checks the error statistics over the localized nodes only
+class LocalizationSummaryTestCase : public TestCase
+{
+public:
+  LocalizationSummaryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LocalizationSummaryTestCase::LocalizationSummaryTestCase ()
+  : TestCase ("DVHopHelper summarizes the localization error")
+{
+}
+
+void
+LocalizationSummaryTestCase::DoRun (void)
+{
+  std::vector<DVHopLocalization> results (3);
+  results[0].localized = true;
+  results[0].error = 3;
+  results[1].localized = false;
+  results[1].error = 0;
+  results[2].localized = true;
+  results[2].error = 4;
+
+  DVHopLocalizationSummary summary = DVHopHelper::Summarize (results);
+  NS_TEST_ASSERT_MSG_EQ (summary.nodes, 3, "Wrong node count");
+  NS_TEST_ASSERT_MSG_EQ (summary.localized, 2, "Wrong localized count");
+  NS_TEST_ASSERT_MSG_EQ_TOL (summary.meanError, 3.5, 1e-9, "Wrong mean error");
+  NS_TEST_ASSERT_MSG_EQ_TOL (summary.rmsError, std::sqrt (12.5), 1e-9, "Wrong RMS error");
+  NS_TEST_ASSERT_MSG_EQ_TOL (summary.maxError, 4, 1e-9, "Wrong max error");
+}
+
+// Nodes sharing one SimpleChannel and running DV-Hop, each one only hears the nodes it is linked to.
+// Node i gets the address 10.1.1.(i + 1)
+class DvhopTestNetwork
+{
+public:
+  DvhopTestNetwork (uint32_t n, DVHopHelper dvhop);
+
+  //Links every node to the next one
+  void Line ();
+  void Link (uint32_t a, uint32_t b);
+  void Unlink (uint32_t a, uint32_t b);
+  void SetBeacon (uint32_t i, double x, double y);
+
+  Ptr<dvhop::RoutingProtocol> Get (uint32_t i) const;
+  Ipv4Address GetAddress (uint32_t i) const { return m_interfaces.GetAddress (i); }
+  NodeContainer const & GetNodes () const { return m_nodes; }
+
+private:
+  Ptr<SimpleNetDevice> GetDevice (uint32_t i) const;
+
+  NodeContainer          m_nodes;
+  NetDeviceContainer     m_devices;
+  Ipv4InterfaceContainer m_interfaces;
+  Ptr<SimpleChannel>     m_channel;
+};
+
+DvhopTestNetwork::DvhopTestNetwork (uint32_t n, DVHopHelper dvhop)
+{
+  //Every network of the suite starts again from the first address
+  Ipv4AddressGenerator::Reset ();
+  m_nodes.Create (n);
+  m_channel = CreateObject<SimpleChannel> ();
+  SimpleNetDeviceHelper simple;
+  m_devices = simple.Install (m_nodes, m_channel);
+  for (uint32_t a = 0; a < n; a++)
+    {
+      for (uint32_t b = 0; b < n; b++)
+        {
+          if (a != b)
+            {
+              m_channel->BlackList (GetDevice (a), GetDevice (b));
+            }
+        }
+    }
+
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (dvhop);
+  stack.Install (m_nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  m_interfaces = address.Assign (m_devices);
+  dvhop.AssignStreams (m_nodes, 0);
+}
+
+void
+DvhopTestNetwork::Line ()
+{
+  for (uint32_t i = 0; i + 1 < m_nodes.GetN (); i++)
+    {
+      Link (i, i + 1);
+    }
+}
+
+void
+DvhopTestNetwork::Link (uint32_t a, uint32_t b)
+{
+  m_channel->UnBlackList (GetDevice (a), GetDevice (b));
+  m_channel->UnBlackList (GetDevice (b), GetDevice (a));
+}
+
+void
+DvhopTestNetwork::Unlink (uint32_t a, uint32_t b)
+{
+  m_channel->BlackList (GetDevice (a), GetDevice (b));
+  m_channel->BlackList (GetDevice (b), GetDevice (a));
+}
+
+void
+DvhopTestNetwork::SetBeacon (uint32_t i, double x, double y)
+{
+  Get (i)->SetIsBeacon (true);
+  Get (i)->SetPosition (x, y);
+}
+
+Ptr<dvhop::RoutingProtocol>
+DvhopTestNetwork::Get (uint32_t i) const
+{
+  return m_nodes.Get (i)->GetObject<dvhop::RoutingProtocol> ();
+}
+
+Ptr<SimpleNetDevice>
+DvhopTestNetwork::GetDevice (uint32_t i) const
+{
+  return DynamicCast<SimpleNetDevice> (m_devices.Get (i));
+}
+
+// One TableUpdate trace of a node
+struct TableUpdateRecord
+{
+  Time        time;
+  Ipv4Address beacon;
+  uint16_t    oldHops;
+  uint16_t    newHops;
+};
+
+static void
+RecordTableUpdate (std::vector<TableUpdateRecord> *records, Ipv4Address beacon, uint16_t oldHops, uint16_t newHops)
+{
+  TableUpdateRecord record;
+  record.time = Simulator::Now ();
+  record.beacon = beacon;
+  record.oldHops = oldHops;
+  record.newHops = newHops;
+  records->push_back (record);
+}
+
+static void
+RecordHelloTx (std::vector<Time> *times, uint32_t /*entries*/, uint32_t /*bytes*/)
+{
+  times->push_back (Simulator::Now ());
+}
+
+static void
+CountStaleEntry (uint32_t *count, Ipv4Address /*beacon*/, uint16_t /*hops*/)
+{
+  (*count)++;
+}
+
+static void
+RecordHopSize (std::vector<uint16_t> *hops, Ipv4Address /*beacon*/, double /*hopSize*/, uint16_t hopCount)
+{
+  hops->push_back (hopCount);
+}
+
+// HELLOs sent in [from, to)
+static uint32_t
+CountBetween (std::vector<Time> const &times, Time from, Time to)
+{
+  uint32_t count = 0;
+  for (size_t i = 0; i < times.size (); i++)
+    {
+      if (times[i] >= from && times[i] < to)
+        {
+          count++;
+        }
+    }
+  return count;
+}
+
+// Checks the Trickle schedule of the HELLOs on a line of three nodes between two beacons
+class TrickleTestCase : public TestCase
+{
+public:
+  TrickleTestCase ();
+
+private:
+  virtual void DoRun (void);
+  //HELLOs sent by each node of the line, moving the first beacon at moveAt
+  void RunLine (uint32_t redundancy, Time moveAt, std::vector<Time> *tx, std::vector<TableUpdateRecord> *updates);
+};
+
+TrickleTestCase::TrickleTestCase ()
+  : TestCase ("Trickle doubles its interval, resets on inconsistent HELLOs and suppresses at k")
+{
+}
+
+void
+TrickleTestCase::RunLine (uint32_t redundancy, Time moveAt, std::vector<Time> *tx, std::vector<TableUpdateRecord> *updates)
+{
+  DVHopHelper dvhop;
+  dvhop.Set ("EnableTrickle", BooleanValue (true));
+  dvhop.Set ("TrickleImin", TimeValue (MilliSeconds (100)));
+  dvhop.Set ("TrickleImax", TimeValue (MilliSeconds (3200)));
+  dvhop.Set ("TrickleRedundancy", UintegerValue (redundancy));
+  DvhopTestNetwork net (3, dvhop);
+  net.Line ();
+  net.SetBeacon (0, 0.0, 0.0);
+  net.SetBeacon (2, 200.0, 0.0);
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      net.Get (i)->TraceConnectWithoutContext ("HelloTx", MakeBoundCallback (&RecordHelloTx, &tx[i]));
+    }
+  net.Get (1)->TraceConnectWithoutContext ("TableUpdate", MakeBoundCallback (&RecordTableUpdate, updates));
+  Simulator::Schedule (moveAt, &dvhop::RoutingProtocol::SetPosition, net.Get (0), 10.0, 0.0);
+
+  Simulator::Stop (Seconds (50));
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+TrickleTestCase::DoRun (void)
+{
+  std::vector<Time> tx[3];
+  std::vector<TableUpdateRecord> updates;
+  RunLine (100, Seconds (40), tx, &updates);
+
+  // Imin while the tables fill, Imax = 32 Imin once they agree
+  std::vector<Time> const &middle = tx[1];
+  NS_TEST_ASSERT_MSG_GT (CountBetween (middle, Seconds (0), Seconds (1)), 2, "Intervals must start at Imin");
+  for (size_t i = 1; i < middle.size (); i++)
+    {
+      if (middle[i - 1] >= Seconds (20) && middle[i] < Seconds (40))
+        {
+          // One HELLO in the second half of each interval, plus the jitter
+          NS_TEST_ASSERT_MSG_GT (middle[i] - middle[i - 1], MilliSeconds (1500), "Intervals must double up to Imax");
+        }
+    }
+  uint32_t steady = CountBetween (middle, Seconds (20), Seconds (40));
+  NS_TEST_ASSERT_MSG_GT (steady, 4, "HELLOs go on at Imax");
+
+  // The moved beacon makes its next HELLO inconsistent with the table of its neighbor
+  Time changed;
+  for (size_t i = 0; i < updates.size (); i++)
+    {
+      if (updates[i].time >= Seconds (40))
+        {
+          changed = updates[i].time;
+          break;
+        }
+    }
+  NS_TEST_ASSERT_MSG_GT (changed, Seconds (40), "The new position must reach the middle node");
+  NS_TEST_ASSERT_MSG_GT (CountBetween (middle, changed, changed + MilliSeconds (500)), 1,
+                         "An inconsistent HELLO must reset the interval to Imin");
+
+  // With k = 1 the middle node mostly stays silent, it hears both beacons every interval
+  std::vector<Time> suppressed[3];
+  updates.clear ();
+  RunLine (1, Seconds (100), suppressed, &updates);
+  NS_TEST_ASSERT_MSG_LT (CountBetween (suppressed[1], Seconds (20), Seconds (40)), steady,
+                         "Consistent HELLOs must suppress ours");
+}
+
+// Checks that beacon entries are flooded along a line, across the sequence number wraparound
+class SequenceNumberTestCase : public TestCase
+{
+public:
+  SequenceNumberTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SequenceNumberTestCase::SequenceNumberTestCase ()
+  : TestCase ("Entries follow newer sequence numbers across the wraparound and drop stale ones")
+{
+}
+
+void
+SequenceNumberTestCase::DoRun (void)
+{
+  DVHopHelper dvhop;
+  DvhopTestNetwork net (3, dvhop);
+  net.Line ();
+  net.SetBeacon (0, 0.0, 0.0);
+
+  // Start close to the end of the sequence number space
+  dvhop::SnapshotNode state;
+  std::memset (&state, 0, sizeof (state));
+  state.flags = dvhop::SnapshotNode::BEACON;
+  state.seqNo = 65500;
+  state.posVersion = net.Get (0)->GetPositionVersion ();
+  net.Get (0)->WarmStart (dvhop::DistanceTable (), state);
+
+  uint32_t stale = 0;
+  std::vector<TableUpdateRecord> updates;
+  net.Get (1)->TraceConnectWithoutContext ("StaleEntry", MakeBoundCallback (&CountStaleEntry, &stale));
+  net.Get (2)->TraceConnectWithoutContext ("TableUpdate", MakeBoundCallback (&RecordTableUpdate, &updates));
+
+  Simulator::Stop (Seconds (60));
+  Simulator::Run ();
+
+  uint16_t seqNo = net.Get (0)->GetSequenceNumber ();
+  NS_TEST_ASSERT_MSG_LT (seqNo, 100, "The beacon sequence number must have wrapped around");
+  dvhop::BeaconInfo const *info = net.Get (2)->GetDistanceTable ().Find (net.GetAddress (0));
+  NS_TEST_ASSERT_MSG_EQ ((info != 0), true, "The beacon must be known two hops away");
+  NS_TEST_ASSERT_MSG_EQ (info->GetHops (), 2, "Wrong hops to the beacon");
+  NS_TEST_ASSERT_MSG_LT (uint16_t (seqNo - info->GetSeqNo ()), 5, "Sequence numbers after the wraparound must be taken");
+  NS_TEST_ASSERT_MSG_EQ (updates.size (), 1, "The entry must only be inserted, never changed");
+
+  // The entry the last node relays back is one hop longer than the one of the middle node
+  NS_TEST_ASSERT_MSG_GT (stale, 0, "Longer entries must be dropped as stale");
+  NS_TEST_ASSERT_MSG_EQ (net.Get (1)->GetDistanceTable ().GetHopsTo (net.GetAddress (0)), 1, "Stale entries must not change the table");
+  Simulator::Destroy ();
+}
+
+// Checks that a beacon entry keeps its shortest path while a longer one brings newer sequence numbers first
+class PathSettlingTestCase : public TestCase
+{
+public:
+  PathSettlingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+PathSettlingTestCase::PathSettlingTestCase ()
+  : TestCase ("Longer paths from other neighbors replace an entry only once its next hop stays silent")
+{
+}
+
+void
+PathSettlingTestCase::DoRun (void)
+{
+  // The last node reaches the beacon in 2 hops through node 1, or 3 hops through nodes 2 and 3.
+  // HELLO rounds only differ by their jitter, so the newer sequence numbers often come the long way first
+  DVHopHelper dvhop;
+  DvhopTestNetwork net (5, dvhop);
+  net.Link (0, 1);
+  net.Link (1, 4);
+  net.Link (0, 2);
+  net.Link (2, 3);
+  net.Link (3, 4);
+  net.SetBeacon (0, 0.0, 0.0);
+
+  std::vector<TableUpdateRecord> updates;
+  net.Get (4)->TraceConnectWithoutContext ("TableUpdate", MakeBoundCallback (&RecordTableUpdate, &updates));
+  // One lost round on the short path, then the short path breaks for good
+  Simulator::Schedule (MilliSeconds (10500), &DvhopTestNetwork::Unlink, &net, 1, 4);
+  Simulator::Schedule (MilliSeconds (11500), &DvhopTestNetwork::Link, &net, 1, 4);
+  Simulator::Schedule (Seconds (20), &DvhopTestNetwork::Unlink, &net, 1, 4);
+  Simulator::Stop (Seconds (20));
+  Simulator::Run ();
+
+  Ipv4Address beacon = net.GetAddress (0);
+  dvhop::BeaconInfo const *info = net.Get (4)->GetDistanceTable ().Find (beacon);
+  NS_TEST_ASSERT_MSG_EQ ((info != 0), true, "The beacon must be known");
+  NS_TEST_ASSERT_MSG_EQ (info->GetHops (), 2, "The shortest path must be kept");
+  NS_TEST_ASSERT_MSG_EQ (info->GetNextHop (), net.GetAddress (1), "Wrong next hop");
+  NS_TEST_ASSERT_MSG_LT (uint16_t (net.Get (0)->GetSequenceNumber () - info->GetSeqNo ()), 3,
+                         "The longer path must still bring the newer sequence numbers");
+  for (size_t i = 0; i < updates.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_LT (updates[i].time, Seconds (5), "The entry must not flap between both paths");
+    }
+
+  updates.clear ();
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+  info = net.Get (4)->GetDistanceTable ().Find (beacon);
+  NS_TEST_ASSERT_MSG_EQ (info->GetHops (), 3, "The longer path must be taken once the next hop is gone");
+  NS_TEST_ASSERT_MSG_EQ (info->GetNextHop (), net.GetAddress (3), "Wrong next hop");
+  NS_TEST_ASSERT_MSG_EQ (updates.size (), 1, "The entry must change once");
+  NS_TEST_ASSERT_MSG_EQ (updates[0].oldHops, 2, "Wrong traced hops");
+  NS_TEST_ASSERT_MSG_EQ (updates[0].newHops, 3, "Wrong traced hops");
+  Simulator::Destroy ();
+}
+
+// Checks that entries not refreshed are purged when a beacon becomes unreachable
+class EntryExpiryTestCase : public TestCase
+{
+public:
+  EntryExpiryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+EntryExpiryTestCase::EntryExpiryTestCase ()
+  : TestCase ("Unreachable beacons expire and are traced, reachable ones are refreshed")
+{
+}
+
+void
+EntryExpiryTestCase::DoRun (void)
+{
+  DVHopHelper dvhop;
+  dvhop.Set ("HelloMode", EnumValue (dvhop::DELTA_HELLO));
+  dvhop.Set ("EntryLifetime", TimeValue (Seconds (3)));
+  DvhopTestNetwork net (3, dvhop);
+  net.Line ();
+  net.SetBeacon (0, 0.0, 0.0);
+  net.SetBeacon (2, 200.0, 0.0);
+
+  std::vector<TableUpdateRecord> updates[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      net.Get (i)->TraceConnectWithoutContext ("TableUpdate", MakeBoundCallback (&RecordTableUpdate, &updates[i]));
+    }
+  Simulator::Schedule (Seconds (10), &DvhopTestNetwork::Unlink, &net, 1, 2);
+  Simulator::Stop (Seconds (20));
+  Simulator::Run ();
+
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((net.Get (i)->GetDistanceTable ().Find (net.GetAddress (2)) == 0), true, "The unreachable beacon must expire");
+      uint32_t expired = 0;
+      for (size_t j = 0; j < updates[i].size (); j++)
+        {
+          TableUpdateRecord const &record = updates[i][j];
+          if (record.newHops == 0)
+            {
+              NS_TEST_ASSERT_MSG_EQ (record.beacon, net.GetAddress (2), "Only the unreachable beacon may expire");
+              NS_TEST_ASSERT_MSG_EQ (record.oldHops, 2 - i, "The expiry must trace the hops of the entry");
+              NS_TEST_ASSERT_MSG_GT (record.time, Seconds (10), "Expired before the link was cut");
+              NS_TEST_ASSERT_MSG_LT (record.time, Seconds (15), "Expired long after the lifetime");
+              expired++;
+            }
+        }
+      NS_TEST_ASSERT_MSG_EQ (expired, 1, "The expiry must be traced once");
+    }
+  // Delta HELLOs carry no unchanged entries, the beacon still refreshes its own
+  NS_TEST_ASSERT_MSG_EQ (net.Get (1)->GetDistanceTable ().GetHopsTo (net.GetAddress (0)), 1, "The reachable beacon must be kept");
+  Simulator::Destroy ();
+}
+
+// Checks that Trickle suppression does not starve the tables when entries expire
+class TrickleAgingTestCase : public TestCase
+{
+public:
+  TrickleAgingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+TrickleAgingTestCase::TrickleAgingTestCase ()
+  : TestCase ("Suppressed Trickle HELLOs still refresh the entries before they expire")
+{
+}
+
+void
+TrickleAgingTestCase::DoRun (void)
+{
+  // The default Imax is ten times the lifetime, and k = 1 silences the middle node most intervals
+  DVHopHelper dvhop;
+  dvhop.Set ("EnableTrickle", BooleanValue (true));
+  dvhop.Set ("TrickleRedundancy", UintegerValue (1));
+  dvhop.Set ("EntryLifetime", TimeValue (Seconds (6)));
+  DvhopTestNetwork net (3, dvhop);
+  net.Line ();
+  net.SetBeacon (0, 0.0, 0.0);
+  net.SetBeacon (2, 200.0, 0.0);
+
+  std::vector<TableUpdateRecord> updates[3];
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      net.Get (i)->TraceConnectWithoutContext ("TableUpdate", MakeBoundCallback (&RecordTableUpdate, &updates[i]));
+    }
+  Simulator::Stop (Seconds (60));
+  Simulator::Run ();
+
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      for (size_t j = 0; j < updates[i].size (); j++)
+        {
+          NS_TEST_ASSERT_MSG_NE (updates[i][j].newHops, 0, "A reachable beacon expired");
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (net.Get (0)->GetDistanceTable ().GetHopsTo (net.GetAddress (2)), 2, "Wrong hops between the beacons");
+  NS_TEST_ASSERT_MSG_EQ (net.Get (2)->GetDistanceTable ().GetHopsTo (net.GetAddress (0)), 2, "Wrong hops between the beacons");
+  NS_TEST_ASSERT_MSG_EQ (net.Get (1)->GetDistanceTable ().GetSize (), 2, "The middle node must keep both beacons");
+  Simulator::Destroy ();
+}
+
+// Checks the flooding of the hop size from the nearest beacon, up to HopSizeScope hops
+class HopSizeFloodingTestCase : public TestCase
+{
+public:
+  HopSizeFloodingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+HopSizeFloodingTestCase::HopSizeFloodingTestCase ()
+  : TestCase ("Beacons compute their hop size and flood it up to the scope")
+{
+}
+
+void
+HopSizeFloodingTestCase::DoRun (void)
+{
+  DVHopHelper dvhop;
+  dvhop.Set ("HopSizeScope", UintegerValue (2));
+  DvhopTestNetwork net (5, dvhop);
+  net.Line ();
+  net.SetBeacon (0, 0.0, 0.0);
+  net.SetBeacon (1, 100.0, 0.0);
+
+  std::vector<uint16_t> hops;
+  net.Get (3)->TraceConnectWithoutContext ("HopSize", MakeBoundCallback (&RecordHopSize, &hops));
+  Simulator::Stop (Seconds (20));
+  Simulator::Run ();
+
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (net.Get (i)->HasHopSize (), true, "Beacons compute their own hop size");
+      NS_TEST_ASSERT_MSG_EQ_TOL (net.Get (i)->GetHopSize (), 100.0, 1e-9, "Wrong beacon hop size");
+    }
+  for (uint32_t i = 2; i < 4; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (net.Get (i)->HasHopSize (), true, "The hop size must reach the scope");
+      NS_TEST_ASSERT_MSG_EQ_TOL (net.Get (i)->GetHopSize (), 100.0, 1e-9, "Wrong flooded hop size");
+      NS_TEST_ASSERT_MSG_EQ (net.Get (i)->GetHopSizeBeacon (), net.GetAddress (1), "The nearest beacon must win");
+      NS_TEST_ASSERT_MSG_EQ (net.Get (i)->GetHopSizeHops (), i - 1, "Wrong hops to the hop size beacon");
+    }
+  NS_TEST_ASSERT_MSG_EQ (net.Get (4)->HasHopSize (), false, "The hop size must not go beyond the scope");
+  NS_TEST_ASSERT_MSG_GT (hops.size (), 0, "The hop size must be traced");
+  NS_TEST_ASSERT_MSG_EQ (hops.back (), 2, "The trace must give the hops to the beacon");
+  Simulator::Destroy ();
+}
+
+// Checks that unicast routes to beacons follow the hop-count gradient
+class GradientRouteTestCase : public TestCase
+{
+public:
+  GradientRouteTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+GradientRouteTestCase::GradientRouteTestCase ()
+  : TestCase ("Routes to beacons go through the neighbor the entry was learned from")
+{
+}
+
+void
+GradientRouteTestCase::DoRun (void)
+{
+  DVHopHelper dvhop;
+  DvhopTestNetwork net (4, dvhop);
+  net.Line ();
+  net.SetBeacon (0, 0.0, 0.0);
+  net.SetBeacon (3, 300.0, 0.0);
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  Ptr<Packet> packet = Create<Packet> ();
+  Ipv4Header header;
+  Socket::SocketErrno sockerr;
+  for (uint32_t i = 1; i < 4; i++)
+    {
+      header.SetDestination (net.GetAddress (0));
+      Ptr<Ipv4Route> route = net.Get (i)->RouteOutput (packet, header, 0, sockerr);
+      NS_TEST_ASSERT_MSG_EQ ((route != 0), true, "Beacons must be routable");
+      NS_TEST_ASSERT_MSG_EQ (sockerr, Socket::ERROR_NOTERROR, "Wrong socket error");
+      NS_TEST_ASSERT_MSG_EQ (route->GetGateway (), net.GetAddress (i - 1), "Wrong next hop toward the beacon");
+      NS_TEST_ASSERT_MSG_EQ (route->GetSource (), net.GetAddress (i), "Wrong source address");
+    }
+
+  // Without geographic forwarding other nodes are only reachable as beacons
+  header.SetDestination (net.GetAddress (2));
+  Ptr<Ipv4Route> route = net.Get (0)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route == 0), true, "Nodes that are not beacons have no route");
+  NS_TEST_ASSERT_MSG_EQ (sockerr, Socket::ERROR_NOROUTETOHOST, "Wrong socket error");
+  Simulator::Destroy ();
+}
+
+// Checks greedy geographic forwarding and its recovery at dead ends
+class GeographicRouteTestCase : public TestCase
+{
+public:
+  GeographicRouteTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+GeographicRouteTestCase::GeographicRouteTestCase ()
+  : TestCase ("Greedy forwarding falls back to the gradient at dead ends and never returns")
+{
+}
+
+void
+GeographicRouteTestCase::DoRun (void)
+{
+  // Node 4 is the destination. Node 0 and node 3 are dead ends: node 1, their only neighbor, is farther
+  // from it. Node 1 greedily prefers node 3, while its path toward beacon 4 goes through node 2
+  DVHopHelper dvhop;
+  dvhop.Set ("GeographicForwarding", BooleanValue (true));
+  DvhopTestNetwork net (5, dvhop);
+  net.Link (0, 1);
+  net.Link (1, 2);
+  net.Link (2, 4);
+  net.Link (1, 3);
+  net.SetBeacon (0, 0.0, 0.0);
+  net.SetBeacon (1, 0.0, 100.0);
+  net.SetBeacon (2, 100.0, 150.0);
+  net.SetBeacon (3, 150.0, 50.0);
+  net.SetBeacon (4, 200.0, 0.0);
+  // Registered next to node 4 without being a beacon
+  Ipv4Address located ("10.1.1.100");
+  dvhop.GetLocationRegistry ()->SetPosition (located, dvhop::Position (200.0, 0.0));
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  Ipv4Header header;
+  Socket::SocketErrno sockerr;
+  dvhop::GradientTag tag;
+  header.SetDestination (net.GetAddress (4));
+
+  Ptr<Packet> packet = Create<Packet> ();
+  Ptr<Ipv4Route> route = net.Get (2)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route != 0), true, "A neighbor destination must be routable");
+  NS_TEST_ASSERT_MSG_EQ (route->GetGateway (), net.GetAddress (4), "A neighbor destination is sent to directly");
+
+  route = net.Get (1)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route != 0), true, "Greedy forwarding must find a closer neighbor");
+  NS_TEST_ASSERT_MSG_EQ (route->GetGateway (), net.GetAddress (3), "Greedy forwarding must pick the closest neighbor");
+  NS_TEST_ASSERT_MSG_EQ (packet->PeekPacketTag (tag), false, "Greedy forwarding must not mark the packet");
+
+  route = net.Get (3)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route != 0), true, "A beacon must stay routable at a dead end");
+  NS_TEST_ASSERT_MSG_EQ (route->GetGateway (), net.GetAddress (1), "A dead end must follow the gradient");
+  NS_TEST_ASSERT_MSG_EQ (packet->PeekPacketTag (tag), true, "A dead end must mark the packet");
+
+  // The marked packet must not go back to the dead end it came from
+  route = net.Get (1)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route != 0), true, "A marked packet must stay routable");
+  NS_TEST_ASSERT_MSG_EQ (route->GetGateway (), net.GetAddress (2), "A marked packet must stay on the gradient");
+
+  packet = Create<Packet> ();
+  route = net.Get (0)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route != 0), true, "A beacon must stay routable at a dead end");
+  NS_TEST_ASSERT_MSG_EQ (route->GetGateway (), net.GetAddress (1), "A dead end must follow the gradient");
+  NS_TEST_ASSERT_MSG_EQ (packet->PeekPacketTag (tag), true, "A dead end must mark the packet");
+
+  // Without perimeter routing only beacons survive a dead end
+  header.SetDestination (located);
+  packet = Create<Packet> ();
+  route = net.Get (1)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route != 0), true, "Greedy forwarding must reach registered nodes");
+  NS_TEST_ASSERT_MSG_EQ (route->GetGateway (), net.GetAddress (3), "Greedy forwarding must pick the closest neighbor");
+  route = net.Get (0)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route == 0), true, "Other destinations are dropped at a dead end");
+  NS_TEST_ASSERT_MSG_EQ (sockerr, Socket::ERROR_NOROUTETOHOST, "Wrong socket error");
+
+  header.SetDestination (Ipv4Address ("10.1.1.200"));
+  route = net.Get (1)->RouteOutput (packet, header, 0, sockerr);
+  NS_TEST_ASSERT_MSG_EQ ((route == 0), true, "Unregistered destinations have no route");
+  NS_TEST_ASSERT_MSG_EQ (sockerr, Socket::ERROR_NOROUTETOHOST, "Wrong socket error");
+  Simulator::Destroy ();
+}
+
+// Checks that a snapshot restores the nodes of the same topology, and only those
+class WarmStartTestCase : public TestCase
+{
+public:
+  WarmStartTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+WarmStartTestCase::WarmStartTestCase ()
+  : TestCase ("Warm start restores the tables of the topology they were saved on")
+{
+}
+
+void
+WarmStartTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("warm-start.snapshot");
+  DVHopHelper dvhop;
+  uint16_t seqNo;
+  double hopSize;
+  {
+    DvhopTestNetwork net (4, dvhop);
+    net.Line ();
+    net.SetBeacon (0, 0.0, 0.0);
+    net.SetBeacon (3, 300.0, 0.0);
+    Simulator::Stop (Seconds (15));
+    Simulator::Run ();
+    NS_TEST_ASSERT_MSG_EQ (net.Get (2)->HasHopSize (), true, "The network must have converged");
+    NS_TEST_ASSERT_MSG_EQ (DVHopHelper::WriteSnapshot (net.GetNodes (), filename), true, "Could not write the snapshot");
+    seqNo = net.Get (0)->GetSequenceNumber ();
+    hopSize = net.Get (2)->GetHopSize ();
+    Simulator::Destroy ();
+  }
+  {
+    // Same nodes, addresses and beacons: restored before the first HELLO
+    DvhopTestNetwork net (4, dvhop);
+    net.Line ();
+    net.SetBeacon (0, 0.0, 0.0);
+    net.SetBeacon (3, 300.0, 0.0);
+    NS_TEST_ASSERT_MSG_EQ (DVHopHelper::LoadSnapshot (net.GetNodes (), filename), true, "The snapshot must be loaded");
+    NS_TEST_ASSERT_MSG_EQ (net.Get (1)->GetDistanceTable ().GetHopsTo (net.GetAddress (3)), 2, "Wrong restored hops");
+    NS_TEST_ASSERT_MSG_EQ (net.Get (2)->GetDistanceTable ().GetHopsTo (net.GetAddress (0)), 2, "Wrong restored hops");
+    NS_TEST_ASSERT_MSG_EQ (net.Get (2)->HasHopSize (), true, "The hop size must be restored");
+    NS_TEST_ASSERT_MSG_EQ_TOL (net.Get (2)->GetHopSize (), hopSize, 1e-9, "Wrong restored hop size");
+    NS_TEST_ASSERT_MSG_EQ (net.Get (0)->GetSequenceNumber (), seqNo, "The beacon must keep its sequence number");
+    Simulator::Destroy ();
+  }
+  {
+    // Another beacon set hashes to another topology
+    DvhopTestNetwork net (4, dvhop);
+    net.Line ();
+    net.SetBeacon (0, 0.0, 0.0);
+    net.SetBeacon (2, 200.0, 0.0);
+    NS_TEST_ASSERT_MSG_EQ (DVHopHelper::LoadSnapshot (net.GetNodes (), filename), false, "Another topology must be rejected");
+    NS_TEST_ASSERT_MSG_EQ (net.Get (1)->GetDistanceTable ().GetSize (), 0, "A rejected snapshot must change nothing");
+    Simulator::Destroy ();
+  }
+  {
+    DvhopTestNetwork net (5, dvhop);
+    net.Line ();
+    net.SetBeacon (0, 0.0, 0.0);
+    net.SetBeacon (3, 300.0, 0.0);
+    NS_TEST_ASSERT_MSG_EQ (DVHopHelper::LoadSnapshot (net.GetNodes (), filename), false, "Another node count must be rejected");
+    Simulator::Destroy ();
+  }
+  {
+    // The right topology, but node 0 saved as an ordinary node
+    DvhopTestNetwork net (4, dvhop);
+    net.Line ();
+    net.SetBeacon (0, 0.0, 0.0);
+    net.SetBeacon (3, 300.0, 0.0);
+    std::string mismatched = CreateTempDirFilename ("warm-start-role.snapshot");
+    dvhop::SnapshotWriter writer;
+    NS_TEST_ASSERT_MSG_EQ (writer.Open (mismatched, Seconds (0)), true, "Could not create the snapshot");
+    writer.SetTopology (DVHopHelper::HashTopology (net.GetNodes ()));
+    for (uint32_t i = 0; i < 4; i++)
+      {
+        dvhop::SnapshotNode state;
+        std::memset (&state, 0, sizeof (state));
+        state.node = net.GetNodes ().Get (i)->GetId ();
+        state.flags = i == 3 ? dvhop::SnapshotNode::BEACON : 0;
+        writer.AddTable (state, dvhop::DistanceTable ());
+      }
+    NS_TEST_ASSERT_MSG_EQ (writer.Close (), true, "Could not write the snapshot");
+    NS_TEST_ASSERT_MSG_EQ (DVHopHelper::LoadSnapshot (net.GetNodes (), mismatched), false, "Another beacon role must be rejected");
+    NS_TEST_ASSERT_MSG_EQ (net.Get (1)->GetDistanceTable ().GetSize (), 0, "A rejected snapshot must change nothing");
+    Simulator::Destroy ();
+  }
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +1417,26 @@ DvhopTestSuite::DvhopTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new DvhopTestCase1, TestCase::QUICK);
+  AddTestCase (new HelloHeaderTestCase, TestCase::QUICK);
+  AddTestCase (new CompactHelloHeaderTestCase, TestCase::QUICK);
+  AddTestCase (new InternedHelloHeaderTestCase, TestCase::QUICK);
+  AddTestCase (new HopSizeHelloHeaderTestCase, TestCase::QUICK);
+  AddTestCase (new DistanceTableDirtyTestCase, TestCase::QUICK);
+  AddTestCase (new DistanceTableLookupTestCase, TestCase::QUICK);
+  AddTestCase (new DistanceSnapshotTestCase, TestCase::QUICK);
+  AddTestCase (new NeighborTableTestCase, TestCase::QUICK);
+  AddTestCase (new LocalizerTestCase, TestCase::QUICK);
+  AddTestCase (new BatchLocalizerTestCase, TestCase::QUICK);
+  AddTestCase (new LocalizationSummaryTestCase, TestCase::QUICK);
+  AddTestCase (new TrickleTestCase, TestCase::QUICK);
+  AddTestCase (new SequenceNumberTestCase, TestCase::QUICK);
+  AddTestCase (new PathSettlingTestCase, TestCase::QUICK);
+  AddTestCase (new EntryExpiryTestCase, TestCase::QUICK);
+  AddTestCase (new TrickleAgingTestCase, TestCase::QUICK);
+  AddTestCase (new HopSizeFloodingTestCase, TestCase::QUICK);
+  AddTestCase (new GradientRouteTestCase, TestCase::QUICK);
+  AddTestCase (new GeographicRouteTestCase, TestCase::QUICK);
+  AddTestCase (new WarmStartTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite